@@ -0,0 +1,512 @@
+#include "archiveextractor.h"
+#include "archivereader.h"
+#include "boundedqueue.h"
+#include "packageverifier.h"
+#include "logger.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtEndian>
+#include <zlib.h>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+const int kChunkSize = 1024 * 1024;
+const int kWriteQueueDepth = 16;
+const int kGzipHeaderSize = 10;
+const int kGzipFlagExtra = 0x04;
+
+// Inflates exactly one gzip member stored at [offset, offset + length)
+class GzipMemberReader {
+public:
+    GzipMemberReader(QFile &file, qint64 length)
+        : file(file)
+        , left(length)
+        , input(kChunkSize, Qt::Uninitialized)
+        , finished(false)
+    {
+        std::memset(&stream, 0, sizeof(stream));
+        valid = inflateInit2(&stream, 16 + MAX_WBITS) == Z_OK;
+    }
+
+    ~GzipMemberReader() {
+        if (valid) {
+            inflateEnd(&stream);
+        }
+    }
+
+    // Returns 0 at the end of the member and -1 on corrupt input
+    qint64 read(char *data, qint64 maxSize) {
+        if (!valid) {
+            return -1;
+        }
+
+        stream.next_out = reinterpret_cast<Bytef *>(data);
+        stream.avail_out = static_cast<uInt>(qMin<qint64>(maxSize, UINT_MAX));
+        uInt requested = stream.avail_out;
+
+        while (stream.avail_out > 0 && !finished) {
+            if (stream.avail_in == 0 && left > 0) {
+                qint64 n = file.read(input.data(), qMin<qint64>(left, input.size()));
+                if (n <= 0) {
+                    return -1;
+                }
+                left -= n;
+                stream.next_in = reinterpret_cast<Bytef *>(input.data());
+                stream.avail_in = static_cast<uInt>(n);
+            }
+
+            int result = inflate(&stream, Z_NO_FLUSH);
+            if (result == Z_STREAM_END) {
+                finished = true;
+            } else if (result != Z_OK) {
+                return -1;
+            }
+        }
+
+        return requested - stream.avail_out;
+    }
+
+private:
+    QFile &file;
+    qint64 left;
+    QByteArray input;
+    z_stream stream;
+    bool valid;
+    bool finished;
+};
+
+struct WriteChunk {
+    QString name;
+    QString path;
+    QByteArray data;
+    bool last;
+};
+
+} // namespace
+
+ArchiveExtractor::ArchiveExtractor(std::shared_ptr<Logger> logger)
+    : logger(logger)
+    , threadCount(qMax(1, QThread::idealThreadCount()))
+    , computeDigests(false)
+    , failed(false)
+    , bytesWritten(0)
+{
+}
+
+void ArchiveExtractor::setThreadCount(int count) {
+    threadCount = qMax(1, count);
+}
+
+void ArchiveExtractor::setComputeDigests(bool enabled) {
+    computeDigests = enabled;
+}
+
+void ArchiveExtractor::setEntryFilter(const QSet<QString> &names) {
+    entryFilter = names;
+}
+
+bool ArchiveExtractor::extract(const QString &archivePath, const QString &extractDir) {
+    failed = false;
+    bytesWritten = 0;
+    errorMessage.clear();
+    digests.clear();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ok = false;
+    ArchiveReader reader(archivePath);
+    switch (reader.getFormat()) {
+    case ArchiveReader::Format::TarGz: {
+        QList<GzipMember> members;
+        if (scanIndependentMembers(archivePath, members)) {
+            logger->info(QString("检测到 %1 个独立 gzip 分块，使用 %2 个线程并行解压")
+                         .arg(members.size()).arg(threadCount));
+            ok = extractMembersParallel(archivePath, members, extractDir);
+        } else {
+            ok = extractTarGzPipelined(archivePath, extractDir);
+        }
+        break;
+    }
+    case ArchiveReader::Format::Zip:
+    case ArchiveReader::Format::BundleV2:
+        ok = extractIndexedParallel(archivePath, extractDir);
+        break;
+    default:
+        fail("不支持的压缩格式");
+        break;
+    }
+
+    if (ok) {
+        // Only what was written counts: a filtered extraction skips most of
+        // the archive
+        qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+        qint64 written = bytesWritten;
+        logger->info(QString("解压完成: 写入 %1 MB，耗时 %2 ms (%3 MB/s)")
+                     .arg(written / (1024.0 * 1024), 0, 'f', 1)
+                     .arg(elapsed)
+                     .arg(written / (1024.0 * 1024) * 1000.0 / elapsed, 0, 'f', 1));
+    } else {
+        logger->error(QString("解压失败: %1").arg(errorMessage));
+    }
+    return ok;
+}
+
+QString ArchiveExtractor::getErrorMessage() const {
+    return errorMessage;
+}
+
+QMap<QString, QString> ArchiveExtractor::getDigests() const {
+    return digests;
+}
+
+bool ArchiveExtractor::scanIndependentMembers(const QString &archivePath, QList<GzipMember> &members) {
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // Each member carries its own total length in a "KP" extra subfield,
+    // so the member table is found by hopping headers, never inflating.
+    qint64 fileSize = file.size();
+    qint64 offset = 0;
+    while (offset < fileSize) {
+        char header[kGzipHeaderSize + 2];
+        if (!file.seek(offset) || file.read(header, sizeof(header)) != sizeof(header)) {
+            return false;
+        }
+        if (static_cast<uchar>(header[0]) != 0x1f || static_cast<uchar>(header[1]) != 0x8b
+                || !(header[3] & kGzipFlagExtra)) {
+            return false;
+        }
+
+        int extraLength = qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(header + kGzipHeaderSize));
+        QByteArray extra = file.read(extraLength);
+        if (extra.size() != extraLength) {
+            return false;
+        }
+
+        qint64 memberLength = 0;
+        int pos = 0;
+        while (pos + 4 <= extra.size()) {
+            int subLength = qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(extra.constData() + pos + 2));
+            if (extra.at(pos) == 'K' && extra.at(pos + 1) == 'P' && subLength == 8 && pos + 12 <= extra.size()) {
+                memberLength = static_cast<qint64>(
+                    qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(extra.constData() + pos + 4)));
+                break;
+            }
+            pos += 4 + subLength;
+        }
+
+        if (memberLength <= 0 || offset + memberLength > fileSize) {
+            return false;
+        }
+        members.append(GzipMember{offset, memberLength});
+        offset += memberLength;
+    }
+
+    // A single member gains nothing over the pipelined path
+    return members.size() > 1;
+}
+
+bool ArchiveExtractor::extractMembersParallel(const QString &archivePath, const QList<GzipMember> &members,
+                                              const QString &extractDir) {
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    QList<QFuture<bool>> futures;
+    for (const GzipMember &member : members) {
+        futures.append(QtConcurrent::run(&pool, [this, archivePath, member, extractDir]() {
+            return extractMember(archivePath, member, extractDir);
+        }));
+    }
+
+    bool ok = true;
+    for (QFuture<bool> &future : futures) {
+        future.waitForFinished();
+        ok = future.result() && ok;
+    }
+    return ok && !failed;
+}
+
+bool ArchiveExtractor::extractMember(const QString &archivePath, const GzipMember &member,
+                                     const QString &extractDir) {
+    if (failed) {
+        return false;
+    }
+
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(member.offset)) {
+        fail(QString("无法打开压缩包: %1").arg(archivePath));
+        return false;
+    }
+
+    GzipMemberReader reader(file, member.length);
+    TarStream tar([&reader](char *data, qint64 maxSize) {
+        return reader.read(data, maxSize);
+    });
+
+    ArchiveEntry entry;
+    while (!failed && tar.next(entry)) {
+        if (!writeTarEntry(tar, entry, extractDir)) {
+            return false;
+        }
+    }
+
+    if (tar.hasError()) {
+        fail(QString("%1 (偏移 %2)").arg(tar.getErrorMessage()).arg(member.offset));
+        return false;
+    }
+    return !failed;
+}
+
+bool ArchiveExtractor::extractTarGzPipelined(const QString &archivePath, const QString &extractDir) {
+    gzFile gz = gzopen(QFile::encodeName(archivePath).constData(), "rb");
+    if (!gz) {
+        fail(QString("无法打开压缩包: %1").arg(archivePath));
+        return false;
+    }
+    gzbuffer(gz, kChunkSize);
+
+    // Inflate here while a writer thread drains finished chunks to disk
+    BoundedQueue<WriteChunk> queue(kWriteQueueDepth);
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    QFuture<void> writer = QtConcurrent::run(&pool, [this, &queue]() {
+        QFile out;
+        std::unique_ptr<Sha256Hasher> hasher;
+        WriteChunk chunk;
+        while (queue.pop(chunk)) {
+            if (failed) {
+                continue;
+            }
+            if (out.fileName() != chunk.path || !out.isOpen()) {
+                out.close();
+                out.setFileName(chunk.path);
+                QDir().mkpath(QFileInfo(chunk.path).absolutePath());
+                if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                    fail(QString("无法写入文件: %1").arg(chunk.path));
+                    queue.close();
+                    continue;
+                }
+                hasher.reset(computeDigests ? new Sha256Hasher() : nullptr);
+            }
+            if (out.write(chunk.data) != chunk.data.size()) {
+                fail(QString("写入文件失败: %1").arg(chunk.path));
+                queue.close();
+                continue;
+            }
+            bytesWritten += chunk.data.size();
+            if (hasher) {
+                hasher->update(chunk.data.constData(), chunk.data.size());
+            }
+            if (chunk.last) {
+                out.close();
+                if (hasher) {
+                    recordDigest(chunk.name, hasher->hexDigest());
+                }
+            }
+        }
+    });
+
+    TarStream tar([gz](char *data, qint64 maxSize) -> qint64 {
+        return gzread(gz, data, static_cast<unsigned>(qMin<qint64>(maxSize, INT_MAX)));
+    });
+
+    ArchiveEntry entry;
+    while (!failed && tar.next(entry)) {
+        QString path;
+        if (!resolvePath(extractDir, entry.name, path)) {
+            break;
+        }
+        if (entry.isDirectory) {
+            QDir().mkpath(path);
+            continue;
+        }
+        if (!entry.isFile || !isWanted(entry)) {
+            continue;
+        }
+
+        qint64 left = entry.size;
+        do {
+            QByteArray data(static_cast<int>(qMin<qint64>(left, kChunkSize)), Qt::Uninitialized);
+            if (tar.readData(data.data(), data.size()) != data.size()) {
+                break;
+            }
+            left -= data.size();
+            if (!queue.push({entry.name, path, data, left == 0})) {
+                break;
+            }
+        } while (left > 0 && !failed);
+    }
+
+    if (tar.hasError()) {
+        fail(tar.getErrorMessage());
+    }
+
+    queue.close();
+    writer.waitForFinished();
+    gzclose(gz);
+    return !failed;
+}
+
+bool ArchiveExtractor::extractIndexedParallel(const QString &archivePath, const QString &extractDir) {
+    ArchiveReader reader(archivePath);
+    QList<ArchiveEntry> entries;
+    if (!reader.readDirectory(entries)) {
+        fail(reader.getErrorMessage());
+        return false;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    QList<QFuture<void>> futures;
+    for (const ArchiveEntry &entry : entries) {
+        QString path;
+        if (!resolvePath(extractDir, entry.name, path)) {
+            break;
+        }
+        if (entry.isDirectory) {
+            QDir().mkpath(path);
+            continue;
+        }
+        if (!isWanted(entry)) {
+            continue;
+        }
+
+        futures.append(QtConcurrent::run(&pool, [this, archivePath, entry, path]() {
+            if (failed) {
+                return;
+            }
+
+            QDir().mkpath(QFileInfo(path).absolutePath());
+            QFile in(archivePath);
+            QFile out(path);
+            if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                fail(QString("无法写入文件: %1").arg(path));
+                return;
+            }
+
+            // Each worker owns its file handles, so entries inflate independently
+            ArchiveReader entryReader(archivePath);
+            bool checkDigest = !entry.digest.isEmpty();
+            std::unique_ptr<Sha256Hasher> hasher(computeDigests || checkDigest ? new Sha256Hasher() : nullptr);
+            bool ok = entryReader.readEntry(in, entry, [this, &out, &hasher](const char *data, qint64 size) {
+                if (hasher) {
+                    hasher->update(data, size);
+                }
+                if (failed || out.write(data, size) != size) {
+                    return false;
+                }
+                bytesWritten += size;
+                return true;
+            });
+            if (ok && hasher) {
+                // v2 bundles carry a digest per entry in their TOC
+                QString digest = hasher->hexDigest();
+                if (checkDigest && digest != entry.digest) {
+                    fail(QString("条目校验和不匹配: %1").arg(entry.name));
+                    return;
+                }
+                if (computeDigests) {
+                    recordDigest(entry.name, digest);
+                }
+            }
+            if (!ok && !failed) {
+                fail(entryReader.getErrorMessage().isEmpty()
+                     ? QString("写入文件失败: %1").arg(path)
+                     : entryReader.getErrorMessage());
+            }
+        }));
+    }
+
+    for (QFuture<void> &future : futures) {
+        future.waitForFinished();
+    }
+    return !failed;
+}
+
+bool ArchiveExtractor::writeTarEntry(TarStream &tar, const ArchiveEntry &entry, const QString &extractDir) {
+    QString path;
+    if (!resolvePath(extractDir, entry.name, path)) {
+        return false;
+    }
+    if (entry.isDirectory) {
+        QDir().mkpath(path);
+        return true;
+    }
+    if (!entry.isFile || !isWanted(entry)) {
+        // TarStream::next() skips the unread data
+        return true;
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile out(path);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        fail(QString("无法写入文件: %1").arg(path));
+        return false;
+    }
+
+    std::unique_ptr<Sha256Hasher> hasher(computeDigests ? new Sha256Hasher() : nullptr);
+    QByteArray buffer(kChunkSize, Qt::Uninitialized);
+    qint64 left = entry.size;
+    while (left > 0) {
+        qint64 n = tar.readData(buffer.data(), qMin<qint64>(left, buffer.size()));
+        if (n <= 0) {
+            fail(tar.getErrorMessage());
+            return false;
+        }
+        if (out.write(buffer.constData(), n) != n) {
+            fail(QString("写入文件失败: %1").arg(path));
+            return false;
+        }
+        bytesWritten += n;
+        if (hasher) {
+            hasher->update(buffer.constData(), n);
+        }
+        left -= n;
+    }
+
+    if (hasher) {
+        recordDigest(entry.name, hasher->hexDigest());
+    }
+    return true;
+}
+
+bool ArchiveExtractor::isWanted(const ArchiveEntry &entry) const {
+    return entryFilter.isEmpty() || entryFilter.contains(entry.name);
+}
+
+bool ArchiveExtractor::resolvePath(const QString &extractDir, const QString &name, QString &path) {
+    // Reject absolute paths and ".." so entries cannot escape extractDir
+    QStringList parts = name.split('/', QString::SkipEmptyParts);
+    if (parts.isEmpty() || parts.contains("..") || name.startsWith('/')) {
+        fail(QString("压缩包包含非法路径: %1").arg(name));
+        return false;
+    }
+    path = QDir(extractDir).filePath(parts.join('/'));
+    return true;
+}
+
+void ArchiveExtractor::recordDigest(const QString &name, const QString &digest) {
+    QMutexLocker locker(&mutex);
+    digests.insert(name, digest);
+}
+
+void ArchiveExtractor::fail(const QString &message) {
+    QMutexLocker locker(&mutex);
+    if (errorMessage.isEmpty()) {
+        errorMessage = message;
+    }
+    failed = true;
+}
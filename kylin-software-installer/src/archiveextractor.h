@@ -0,0 +1,77 @@
+#ifndef ARCHIVEEXTRACTOR_H
+#define ARCHIVEEXTRACTOR_H
+
+#include <QString>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QMutex>
+#include <atomic>
+#include <memory>
+
+class Logger;
+class TarStream;
+struct ArchiveEntry;
+
+// Unpacks tar.gz, zip and v2 bundles using all available cores.
+//
+// - tar.gz written as independent gzip members (see INTEGRATION_GUIDE.md)
+//   is inflated member-by-member across a thread pool;
+// - any other tar.gz is inflated on the calling thread while a writer
+//   thread puts the files on disk;
+// - zip and v2 bundle entries are inflated concurrently across a thread
+//   pool, each worker reading only its own entry's byte range.
+class ArchiveExtractor {
+public:
+    explicit ArchiveExtractor(std::shared_ptr<Logger> logger);
+
+    // Limit the number of worker threads (defaults to the core count)
+    void setThreadCount(int count);
+
+    // Hash every file with SHA-256 while it is written
+    void setComputeDigests(bool enabled);
+
+    // Only write files with these entry names (all files when empty);
+    // the rest are skipped without touching the disk
+    void setEntryFilter(const QSet<QString> &names);
+
+    // Extract the whole archive into extractDir
+    bool extract(const QString &archivePath, const QString &extractDir);
+
+    // Digests of extracted files keyed by entry name, if enabled
+    QMap<QString, QString> getDigests() const;
+
+    // Get error message
+    QString getErrorMessage() const;
+
+private:
+    struct GzipMember {
+        qint64 offset;
+        qint64 length;
+    };
+
+    bool scanIndependentMembers(const QString &archivePath, QList<GzipMember> &members);
+    bool extractMembersParallel(const QString &archivePath, const QList<GzipMember> &members,
+                                const QString &extractDir);
+    bool extractMember(const QString &archivePath, const GzipMember &member,
+                       const QString &extractDir);
+    bool extractTarGzPipelined(const QString &archivePath, const QString &extractDir);
+    bool extractIndexedParallel(const QString &archivePath, const QString &extractDir);
+    bool writeTarEntry(TarStream &tar, const ArchiveEntry &entry, const QString &extractDir);
+    bool isWanted(const ArchiveEntry &entry) const;
+    bool resolvePath(const QString &extractDir, const QString &name, QString &path);
+    void recordDigest(const QString &name, const QString &digest);
+    void fail(const QString &message);
+
+    std::shared_ptr<Logger> logger;
+    int threadCount;
+    bool computeDigests;
+    QSet<QString> entryFilter;
+    std::atomic<bool> failed;
+    std::atomic<qint64> bytesWritten;       // file data written by extract()
+    QMutex mutex;
+    QString errorMessage;
+    QMap<QString, QString> digests;
+};
+
+#endif // ARCHIVEEXTRACTOR_H
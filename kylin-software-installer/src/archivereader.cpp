@@ -0,0 +1,973 @@
+#include "archivereader.h"
+#include "packageverifier.h"
+
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QtEndian>
+#include <zlib.h>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+const int kTarBlockSize = 512;
+const qint64 kZipEocdSize = 22;
+const qint64 kZipMaxCommentSize = 0xFFFF;
+const int kZipCentralHeaderSize = 46;
+const int kZipLocalHeaderSize = 30;
+const quint32 kZipEocdSignature = 0x06054b50;
+const quint32 kZip64LocatorSignature = 0x07064b50;
+const quint32 kZip64EocdSignature = 0x06064b50;
+const quint32 kZipCentralSignature = 0x02014b50;
+const quint32 kZipLocalSignature = 0x04034b50;
+const int kChunkSize = 128 * 1024;
+
+// Bundle v2: header, entry data, TOC, footer; all integers little-endian
+const char kBundleMagic[] = "KYBUNDL2";
+const int kBundleMagicSize = 8;
+const int kBundleHeaderSize = 16;
+const int kBundleFooterSize = 32;
+const int kBundleTocFixedSize = 2 + 1 + 8 + 8 + 8 + 32;
+const qint64 kBundleTailSize = 64 * 1024;
+
+// Entries read into memory are manifests; package files are streamed
+const qint64 kDefaultMaxEntrySize = 256 * 1024 * 1024;
+
+quint16 readLE16(const char *data) {
+    return qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(data));
+}
+
+quint32 readLE32(const char *data) {
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(data));
+}
+
+quint64 readLE64(const char *data) {
+    return qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(data));
+}
+
+QString tarString(const char *field, int length) {
+    return QString::fromUtf8(field, static_cast<int>(qstrnlen(field, length)));
+}
+
+qint64 tarNumber(const char *field, int length) {
+    // GNU base-256 encoding for values that do not fit in octal
+    if (static_cast<unsigned char>(field[0]) & 0x80) {
+        qint64 value = static_cast<unsigned char>(field[0]) & 0x7f;
+        for (int i = 1; i < length; ++i) {
+            value = (value << 8) | static_cast<unsigned char>(field[i]);
+        }
+        return value;
+    }
+
+    int i = 0;
+    while (i < length && field[i] == ' ') {
+        ++i;
+    }
+
+    qint64 value = 0;
+    for (; i < length && field[i] >= '0' && field[i] <= '7'; ++i) {
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+bool isZeroBlock(const char *block) {
+    for (int i = 0; i < kTarBlockSize; ++i) {
+        if (block[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checksumMatches(const char *block) {
+    qint64 expected = tarNumber(block + 148, 8);
+    qint64 sum = 0;
+    for (int i = 0; i < kTarBlockSize; ++i) {
+        // The checksum field itself counts as spaces
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(block[i]);
+    }
+    return sum == expected;
+}
+
+// Parse "<len> <key>=<value>\n" pax records
+QMap<QString, QString> parsePaxRecords(const QByteArray &data) {
+    QMap<QString, QString> records;
+    int pos = 0;
+    while (pos < data.size()) {
+        int space = data.indexOf(' ', pos);
+        if (space < 0) {
+            break;
+        }
+        int length = data.mid(pos, space - pos).toInt();
+        if (length <= 0 || pos + length > data.size()) {
+            break;
+        }
+        QByteArray record = data.mid(space + 1, pos + length - space - 2);
+        int equals = record.indexOf('=');
+        if (equals > 0) {
+            records.insert(QString::fromUtf8(record.left(equals)),
+                           QString::fromUtf8(record.mid(equals + 1)));
+        }
+        pos += length;
+    }
+    return records;
+}
+
+} // namespace
+
+const char *EntryData::data() const {
+    return mapped ? mapped : buffer.constData();
+}
+
+qint64 EntryData::size() const {
+    return mapped ? length : buffer.size();
+}
+
+bool EntryData::isMapped() const {
+    return mapped != nullptr;
+}
+
+TarStream::TarStream(ReadFunction read)
+    : read(read)
+    , remaining(0)
+    , padding(0)
+    , failed(false)
+{
+}
+
+bool TarStream::next(ArchiveEntry &entry) {
+    if (failed || !skipData()) {
+        return false;
+    }
+
+    QString longName;
+    QMap<QString, QString> pax;
+    char block[kTarBlockSize];
+
+    while (true) {
+        // Some writers omit the end-of-archive blocks entirely
+        qint64 n = read(block, kTarBlockSize);
+        if (n == 0) {
+            return false;
+        }
+        if (n < 0 || (n < kTarBlockSize && !readFully(block + n, kTarBlockSize - n))) {
+            failed = true;
+            errorMessage = "tar 数据意外结束";
+            return false;
+        }
+        if (isZeroBlock(block)) {
+            return false;
+        }
+        if (!checksumMatches(block)) {
+            failed = true;
+            errorMessage = "tar 头部校验和错误";
+            return false;
+        }
+
+        char type = block[156];
+        qint64 size = tarNumber(block + 124, 12);
+
+        if (type == 'L' || type == 'x' || type == 'g') {
+            QByteArray data;
+            if (!readExtension(size, data)) {
+                return false;
+            }
+            if (type == 'L') {
+                longName = QString::fromUtf8(data.constData(), static_cast<int>(qstrnlen(data.constData(), data.size())));
+            } else if (type == 'x') {
+                pax = parsePaxRecords(data);
+            }
+            continue;
+        }
+
+        QString name;
+        if (pax.contains("path")) {
+            name = pax.value("path");
+        } else if (!longName.isEmpty()) {
+            name = longName;
+        } else {
+            name = tarString(block, 100);
+            QString prefix = tarString(block + 345, 155);
+            if (std::memcmp(block + 257, "ustar", 5) == 0 && !prefix.isEmpty()) {
+                name = prefix + "/" + name;
+            }
+        }
+        if (pax.contains("size")) {
+            size = pax.value("size").toLongLong();
+        }
+
+        entry = ArchiveEntry();
+        entry.name = ArchiveReader::normalizeName(name);
+        entry.isDirectory = (type == '5');
+        entry.isFile = (type == '0' || type == '\0' || type == '7');
+        entry.size = (type == '1' || type == '2' || entry.isDirectory) ? 0 : size;
+        entry.compressedSize = entry.size;
+
+        remaining = entry.size;
+        padding = (kTarBlockSize - entry.size % kTarBlockSize) % kTarBlockSize;
+        return true;
+    }
+}
+
+qint64 TarStream::readData(char *data, qint64 maxSize) {
+    qint64 toRead = qMin(maxSize, remaining);
+    if (toRead <= 0) {
+        return 0;
+    }
+    if (!readFully(data, toRead)) {
+        return -1;
+    }
+    remaining -= toRead;
+    return toRead;
+}
+
+bool TarStream::skipData() {
+    if (!skipBytes(remaining + padding)) {
+        return false;
+    }
+    remaining = 0;
+    padding = 0;
+    return true;
+}
+
+bool TarStream::hasError() const {
+    return failed;
+}
+
+QString TarStream::getErrorMessage() const {
+    return errorMessage;
+}
+
+bool TarStream::readFully(char *data, qint64 size) {
+    while (size > 0) {
+        qint64 n = read(data, size);
+        if (n <= 0) {
+            failed = true;
+            errorMessage = "tar 数据意外结束";
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool TarStream::skipBytes(qint64 size) {
+    char buffer[16 * 1024];
+    while (size > 0) {
+        qint64 chunk = qMin<qint64>(size, sizeof(buffer));
+        if (!readFully(buffer, chunk)) {
+            return false;
+        }
+        size -= chunk;
+    }
+    return true;
+}
+
+bool TarStream::readExtension(qint64 size, QByteArray &data) {
+    // Extension headers are small; refuse anything absurd
+    if (size < 0 || size > 1024 * 1024) {
+        failed = true;
+        errorMessage = "tar 扩展头部过大";
+        return false;
+    }
+    data.resize(static_cast<int>(size));
+    if (!readFully(data.data(), size)) {
+        return false;
+    }
+    return skipBytes((kTarBlockSize - size % kTarBlockSize) % kTarBlockSize);
+}
+
+ArchiveReader::ArchiveReader(const QString &archivePath)
+    : archivePath(archivePath)
+    , format(Format::Unknown)
+    , maxEntrySize(kDefaultMaxEntrySize)
+{
+    QFile file(archivePath);
+    if (file.open(QIODevice::ReadOnly)) {
+        QByteArray magic = file.read(kBundleMagicSize);
+        if (magic.startsWith("\x1f\x8b")) {
+            format = Format::TarGz;
+        } else if (magic.startsWith(QByteArray("PK\x03\x04", 4)) || magic.startsWith(QByteArray("PK\x05\x06", 4))) {
+            format = Format::Zip;
+        } else if (magic == QByteArray(kBundleMagic, kBundleMagicSize)) {
+            format = Format::BundleV2;
+        }
+    }
+}
+
+ArchiveReader::Format ArchiveReader::getFormat() const {
+    return format;
+}
+
+void ArchiveReader::setMaxEntrySize(qint64 bytes) {
+    maxEntrySize = qBound<qint64>(0, bytes, INT_MAX);
+}
+
+bool ArchiveReader::checkEntrySize(const ArchiveEntry &entry) {
+    // A corrupted size field must not turn into a huge allocation
+    if (entry.size < 0 || entry.size > maxEntrySize) {
+        errorMessage = QString("条目过大: %1 (%2 字节)").arg(entry.name).arg(entry.size);
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveReader::readEntries(const QStringList &names, QMap<QString, QByteArray> &contents) {
+    switch (format) {
+    case Format::TarGz:
+        return readTarGzEntries(names, contents);
+    case Format::Zip:
+    case Format::BundleV2:
+        return readIndexedEntries(names, contents);
+    default:
+        errorMessage = "不支持的压缩格式";
+        return false;
+    }
+}
+
+bool ArchiveReader::mapEntries(const QStringList &names, QMap<QString, EntryData> &contents) {
+    if (format != Format::BundleV2) {
+        QMap<QString, QByteArray> buffers;
+        if (!readEntries(names, buffers)) {
+            return false;
+        }
+        for (auto it = buffers.constBegin(); it != buffers.constEnd(); ++it) {
+            EntryData entry;
+            entry.buffer = it.value();
+            contents.insert(it.key(), entry);
+        }
+        return true;
+    }
+
+    QList<ArchiveEntry> entries;
+    if (!readBundleDirectory(entries)) {
+        return false;
+    }
+
+    auto file = std::make_shared<QFile>(archivePath);
+    if (!file->open(QIODevice::ReadOnly)) {
+        errorMessage = QString("无法打开压缩包: %1").arg(archivePath);
+        return false;
+    }
+
+    for (const ArchiveEntry &entry : entries) {
+        if (!entry.isFile || !names.contains(entry.name)) {
+            continue;
+        }
+
+        EntryData data;
+        uchar *mapped = nullptr;
+        if (entry.method == 0 && entry.size > 0 && entry.compressedSize == entry.size) {
+            mapped = file->map(entry.offset, entry.size);
+        }
+        if (mapped) {
+            data.file = file;
+            data.mapped = reinterpret_cast<const char *>(mapped);
+            data.length = entry.size;
+        } else {
+            // Compressed entries, or mapping refused by the file system
+            if (!checkEntrySize(entry)) {
+                return false;
+            }
+            data.buffer.reserve(static_cast<int>(entry.size));
+            bool ok = readBundleEntry(*file, entry, [&data](const char *chunk, qint64 size) {
+                data.buffer.append(chunk, static_cast<int>(size));
+                return true;
+            });
+            if (!ok) {
+                return false;
+            }
+        }
+
+        Sha256Hasher hasher;
+        hasher.update(data.data(), data.size());
+        if (hasher.hexDigest() != entry.digest) {
+            errorMessage = QString("条目校验和不匹配: %1").arg(entry.name);
+            return false;
+        }
+        contents.insert(entry.name, data);
+    }
+
+    return true;
+}
+
+bool ArchiveReader::streamEntries(const QStringList &names, const EntryStreamHandler &handler) {
+    switch (format) {
+    case Format::TarGz:
+        return streamTarGzEntries(names, handler);
+    case Format::Zip:
+    case Format::BundleV2:
+        return streamIndexedEntries(names, handler);
+    default:
+        errorMessage = "不支持的压缩格式";
+        return false;
+    }
+}
+
+bool ArchiveReader::readDirectory(QList<ArchiveEntry> &entries) {
+    switch (format) {
+    case Format::Zip:
+        return readZipDirectory(entries);
+    case Format::BundleV2:
+        return readBundleDirectory(entries);
+    default:
+        errorMessage = "压缩包没有目录";
+        return false;
+    }
+}
+
+bool ArchiveReader::readEntry(QFile &file, const ArchiveEntry &entry,
+                              const std::function<bool(const char *, qint64)> &sink) {
+    return format == Format::BundleV2 ? readBundleEntry(file, entry, sink)
+                                      : readZipEntry(file, entry, sink);
+}
+
+QString ArchiveReader::getErrorMessage() const {
+    return errorMessage;
+}
+
+QString ArchiveReader::normalizeName(const QString &name) {
+    QString result = name;
+    while (result.startsWith("./")) {
+        result.remove(0, 2);
+    }
+    while (result.startsWith('/')) {
+        result.remove(0, 1);
+    }
+    return result;
+}
+
+bool ArchiveReader::readTarGzEntries(const QStringList &names, QMap<QString, QByteArray> &contents) {
+    gzFile gz = gzopen(QFile::encodeName(archivePath).constData(), "rb");
+    if (!gz) {
+        errorMessage = QString("无法打开压缩包: %1").arg(archivePath);
+        return false;
+    }
+    gzbuffer(gz, kChunkSize);
+
+    TarStream tar([gz](char *data, qint64 maxSize) -> qint64 {
+        return gzread(gz, data, static_cast<unsigned>(qMin<qint64>(maxSize, INT_MAX)));
+    });
+
+    QSet<QString> pending;
+    for (const QString &name : names) {
+        pending.insert(name);
+    }
+    ArchiveEntry entry;
+    bool ok = true;
+
+    // Stop as soon as every requested entry has been seen
+    while (!pending.isEmpty() && tar.next(entry)) {
+        if (!entry.isFile || !pending.contains(entry.name)) {
+            continue;
+        }
+
+        if (!checkEntrySize(entry)) {
+            ok = false;
+            break;
+        }
+        QByteArray data;
+        data.resize(static_cast<int>(entry.size));
+        if (tar.readData(data.data(), entry.size) != entry.size) {
+            ok = false;
+            break;
+        }
+        contents.insert(entry.name, data);
+        pending.remove(entry.name);
+    }
+
+    if (tar.hasError()) {
+        errorMessage = tar.getErrorMessage();
+        ok = false;
+    }
+
+    gzclose(gz);
+    return ok;
+}
+
+bool ArchiveReader::readIndexedEntries(const QStringList &names, QMap<QString, QByteArray> &contents) {
+    QList<ArchiveEntry> entries;
+    if (!readDirectory(entries)) {
+        return false;
+    }
+
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = QString("无法打开压缩包: %1").arg(archivePath);
+        return false;
+    }
+
+    for (const ArchiveEntry &entry : entries) {
+        if (!entry.isFile || !names.contains(entry.name)) {
+            continue;
+        }
+
+        if (!checkEntrySize(entry)) {
+            return false;
+        }
+        QByteArray data;
+        data.reserve(static_cast<int>(entry.size));
+        bool ok = readEntry(file, entry, [&data](const char *chunk, qint64 size) {
+            data.append(chunk, static_cast<int>(size));
+            return true;
+        });
+        if (!ok) {
+            return false;
+        }
+
+        if (!entry.digest.isEmpty()) {
+            Sha256Hasher hasher;
+            hasher.update(data.constData(), data.size());
+            if (hasher.hexDigest() != entry.digest) {
+                errorMessage = QString("条目校验和不匹配: %1").arg(entry.name);
+                return false;
+            }
+        }
+        contents.insert(entry.name, data);
+    }
+
+    return true;
+}
+
+bool ArchiveReader::streamTarGzEntries(const QStringList &names, const EntryStreamHandler &handler) {
+    gzFile gz = gzopen(QFile::encodeName(archivePath).constData(), "rb");
+    if (!gz) {
+        errorMessage = QString("无法打开压缩包: %1").arg(archivePath);
+        return false;
+    }
+    gzbuffer(gz, kChunkSize);
+
+    TarStream tar([gz](char *data, qint64 maxSize) -> qint64 {
+        return gzread(gz, data, static_cast<unsigned>(qMin<qint64>(maxSize, INT_MAX)));
+    });
+
+    QSet<QString> pending;
+    for (const QString &name : names) {
+        pending.insert(name);
+    }
+    QByteArray buffer(kChunkSize, Qt::Uninitialized);
+    ArchiveEntry entry;
+    bool ok = true;
+
+    // A tar stream has no index, so entries come in archive order
+    while (ok && !pending.isEmpty() && tar.next(entry)) {
+        if (!entry.isFile || !pending.contains(entry.name)) {
+            continue;
+        }
+        pending.remove(entry.name);
+
+        ok = handler.begin(entry);
+        qint64 remaining = entry.size;
+        while (ok && remaining > 0) {
+            qint64 n = tar.readData(buffer.data(), qMin<qint64>(remaining, buffer.size()));
+            if (n <= 0) {
+                errorMessage = QString("数据意外结束: %1").arg(entry.name);
+                ok = false;
+                break;
+            }
+            ok = handler.data(buffer.constData(), n);
+            remaining -= n;
+        }
+        ok = ok && handler.end(entry);
+    }
+
+    if (tar.hasError()) {
+        errorMessage = tar.getErrorMessage();
+        ok = false;
+    }
+
+    gzclose(gz);
+    return ok;
+}
+
+bool ArchiveReader::streamIndexedEntries(const QStringList &names, const EntryStreamHandler &handler) {
+    QList<ArchiveEntry> entries;
+    if (!readDirectory(entries)) {
+        return false;
+    }
+
+    QHash<QString, ArchiveEntry> byName;
+    for (const ArchiveEntry &entry : entries) {
+        if (entry.isFile) {
+            byName.insert(entry.name, entry);
+        }
+    }
+
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = QString("无法打开压缩包: %1").arg(archivePath);
+        return false;
+    }
+
+    for (const QString &name : names) {
+        auto it = byName.constFind(name);
+        if (it == byName.constEnd()) {
+            continue;
+        }
+        if (!handler.begin(*it) || !readEntry(file, *it, handler.data) || !handler.end(*it)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ArchiveReader::readZipDirectory(QList<ArchiveEntry> &entries) {
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = QString("无法打开压缩包: %1").arg(archivePath);
+        return false;
+    }
+
+    // Locate the end of central directory record
+    qint64 fileSize = file.size();
+    qint64 tailSize = qMin(fileSize, kZipEocdSize + kZipMaxCommentSize);
+    file.seek(fileSize - tailSize);
+    QByteArray tail = file.read(tailSize);
+
+    int eocd = -1;
+    for (int i = tail.size() - kZipEocdSize; i >= 0; --i) {
+        if (readLE32(tail.constData() + i) == kZipEocdSignature) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0) {
+        errorMessage = "zip 中央目录缺失";
+        return false;
+    }
+
+    const char *record = tail.constData() + eocd;
+    quint64 entryCount = readLE16(record + 10);
+    quint64 directorySize = readLE32(record + 12);
+    quint64 directoryOffset = readLE32(record + 16);
+
+    // Zip64 archives keep the real values in a separate record
+    if (entryCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) {
+        qint64 locatorPos = fileSize - tailSize + eocd - 20;
+        if (locatorPos < 0 || !file.seek(locatorPos)) {
+            errorMessage = "zip64 定位记录缺失";
+            return false;
+        }
+        QByteArray locator = file.read(20);
+        if (locator.size() != 20 || readLE32(locator.constData()) != kZip64LocatorSignature) {
+            errorMessage = "zip64 定位记录缺失";
+            return false;
+        }
+        if (!file.seek(static_cast<qint64>(readLE64(locator.constData() + 8)))) {
+            errorMessage = "zip64 目录记录无效";
+            return false;
+        }
+        QByteArray zip64 = file.read(56);
+        if (zip64.size() != 56 || readLE32(zip64.constData()) != kZip64EocdSignature) {
+            errorMessage = "zip64 目录记录无效";
+            return false;
+        }
+        entryCount = readLE64(zip64.constData() + 32);
+        directorySize = readLE64(zip64.constData() + 40);
+        directoryOffset = readLE64(zip64.constData() + 48);
+    }
+
+    if (directorySize > INT_MAX || directoryOffset > static_cast<quint64>(fileSize)
+            || directorySize > static_cast<quint64>(fileSize) - directoryOffset) {
+        errorMessage = "zip 中央目录超出文件范围";
+        return false;
+    }
+    // Each record takes at least a fixed header, so a larger count is corrupt
+    if (entryCount > directorySize / kZipCentralHeaderSize) {
+        errorMessage = "zip 中央目录条目数无效";
+        return false;
+    }
+    file.seek(static_cast<qint64>(directoryOffset));
+    QByteArray directory = file.read(static_cast<qint64>(directorySize));
+    if (directory.size() != static_cast<int>(directorySize)) {
+        errorMessage = "读取 zip 中央目录失败";
+        return false;
+    }
+
+    entries.reserve(static_cast<int>(entryCount));
+    int pos = 0;
+    for (quint64 i = 0; i < entryCount; ++i) {
+        if (pos + kZipCentralHeaderSize > directory.size()
+                || readLE32(directory.constData() + pos) != kZipCentralSignature) {
+            errorMessage = "zip 中央目录损坏";
+            return false;
+        }
+
+        const char *header = directory.constData() + pos;
+        int nameLength = readLE16(header + 28);
+        int extraLength = readLE16(header + 30);
+        int commentLength = readLE16(header + 32);
+        if (pos + kZipCentralHeaderSize + nameLength + extraLength + commentLength > directory.size()) {
+            errorMessage = "zip 中央目录损坏";
+            return false;
+        }
+
+        ArchiveEntry entry;
+        QString name = QString::fromUtf8(header + kZipCentralHeaderSize, nameLength);
+        entry.name = normalizeName(name);
+        entry.isDirectory = name.endsWith('/');
+        entry.isFile = !entry.isDirectory;
+        entry.method = readLE16(header + 10);
+        entry.crc32 = readLE32(header + 16);
+        quint64 compressedSize = readLE32(header + 20);
+        quint64 size = readLE32(header + 24);
+        quint64 offset = readLE32(header + 42);
+
+        // Zip64 extended information extra field
+        const char *extra = header + kZipCentralHeaderSize + nameLength;
+        int extraPos = 0;
+        while (extraPos + 4 <= extraLength) {
+            quint16 id = readLE16(extra + extraPos);
+            quint16 length = readLE16(extra + extraPos + 2);
+            if (extraPos + 4 + length > extraLength) {
+                break;
+            }
+            if (id == 0x0001) {
+                const char *field = extra + extraPos + 4;
+                int fieldPos = 0;
+                if (size == 0xFFFFFFFF && fieldPos + 8 <= length) {
+                    size = readLE64(field + fieldPos);
+                    fieldPos += 8;
+                }
+                if (compressedSize == 0xFFFFFFFF && fieldPos + 8 <= length) {
+                    compressedSize = readLE64(field + fieldPos);
+                    fieldPos += 8;
+                }
+                if (offset == 0xFFFFFFFF && fieldPos + 8 <= length) {
+                    offset = readLE64(field + fieldPos);
+                }
+            }
+            extraPos += 4 + length;
+        }
+
+        entry.size = static_cast<qint64>(size);
+        entry.compressedSize = static_cast<qint64>(compressedSize);
+        entry.offset = static_cast<qint64>(offset);
+        entries.append(entry);
+
+        pos += kZipCentralHeaderSize + nameLength + extraLength + commentLength;
+    }
+
+    return true;
+}
+
+bool ArchiveReader::readZipEntry(QFile &file, const ArchiveEntry &entry,
+                                 const std::function<bool(const char *, qint64)> &sink) {
+    char header[kZipLocalHeaderSize];
+    if (!file.seek(entry.offset)
+            || file.read(header, kZipLocalHeaderSize) != kZipLocalHeaderSize
+            || readLE32(header) != kZipLocalSignature) {
+        errorMessage = QString("zip 本地头部无效: %1").arg(entry.name);
+        return false;
+    }
+    qint64 dataOffset = entry.offset + kZipLocalHeaderSize + readLE16(header + 26) + readLE16(header + 28);
+    if (!file.seek(dataOffset)) {
+        errorMessage = QString("zip 数据偏移无效: %1").arg(entry.name);
+        return false;
+    }
+
+    quint32 crc = 0;
+    if (!copyEntryData(file, entry, sink, crc)) {
+        return false;
+    }
+
+    if (crc != entry.crc32) {
+        errorMessage = QString("zip CRC 校验失败: %1").arg(entry.name);
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveReader::readBundleDirectory(QList<ArchiveEntry> &entries) {
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = QString("无法打开压缩包: %1").arg(archivePath);
+        return false;
+    }
+
+    // One read of the tail usually holds both the footer and the TOC
+    qint64 fileSize = file.size();
+    if (fileSize < kBundleHeaderSize + kBundleFooterSize) {
+        errorMessage = "v2 软件包过短";
+        return false;
+    }
+    qint64 tailStart = fileSize - qMin(fileSize, kBundleTailSize);
+    file.seek(tailStart);
+    QByteArray tail = file.read(fileSize - tailStart);
+    if (tail.size() != fileSize - tailStart) {
+        errorMessage = "读取 v2 软件包尾部失败";
+        return false;
+    }
+
+    const char *footer = tail.constData() + tail.size() - kBundleFooterSize;
+    if (memcmp(footer + 24, kBundleMagic, kBundleMagicSize) != 0) {
+        errorMessage = "v2 软件包尾部标识无效";
+        return false;
+    }
+    quint64 tocOffset = readLE64(footer);
+    quint64 tocSize = readLE64(footer + 8);
+    quint32 entryCount = readLE32(footer + 16);
+    quint32 tocCrc = readLE32(footer + 20);
+
+    quint64 tocEnd = static_cast<quint64>(fileSize - kBundleFooterSize);
+    if (tocOffset < static_cast<quint64>(kBundleHeaderSize) || tocOffset > tocEnd
+            || tocSize != tocEnd - tocOffset || tocSize > INT_MAX) {
+        errorMessage = "v2 软件包目录超出文件范围";
+        return false;
+    }
+
+    QByteArray toc;
+    if (static_cast<qint64>(tocOffset) >= tailStart) {
+        toc = tail.mid(static_cast<int>(tocOffset - tailStart), static_cast<int>(tocSize));
+    } else {
+        file.seek(static_cast<qint64>(tocOffset));
+        toc = file.read(static_cast<qint64>(tocSize));
+    }
+    if (toc.size() != static_cast<int>(tocSize)
+            || crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(toc.constData()),
+                     static_cast<uInt>(toc.size())) != tocCrc) {
+        errorMessage = "v2 软件包目录损坏";
+        return false;
+    }
+
+    // The CRC does not cover the footer, so bound the count by the
+    // smallest possible record before reserving for it
+    if (entryCount > tocSize / kBundleTocFixedSize) {
+        errorMessage = "v2 软件包目录条目数无效";
+        return false;
+    }
+
+    entries.reserve(static_cast<int>(entryCount));
+    int pos = 0;
+    for (quint32 i = 0; i < entryCount; ++i) {
+        if (pos + 2 > toc.size()) {
+            errorMessage = "v2 软件包目录损坏";
+            return false;
+        }
+        int nameLength = readLE16(toc.constData() + pos);
+        if (pos + nameLength + kBundleTocFixedSize > toc.size()) {
+            errorMessage = "v2 软件包目录损坏";
+            return false;
+        }
+
+        const char *record = toc.constData() + pos + 2;
+        ArchiveEntry entry;
+        entry.name = normalizeName(QString::fromUtf8(record, nameLength));
+        entry.isFile = true;
+        record += nameLength;
+        entry.method = static_cast<uchar>(record[0]);
+        entry.offset = static_cast<qint64>(readLE64(record + 1));
+        entry.compressedSize = static_cast<qint64>(readLE64(record + 9));
+        entry.size = static_cast<qint64>(readLE64(record + 17));
+        entry.digest = QString::fromLatin1(QByteArray(record + 25, 32).toHex());
+
+        if (entry.offset < kBundleHeaderSize || entry.compressedSize < 0
+                || static_cast<quint64>(entry.offset + entry.compressedSize) > tocOffset) {
+            errorMessage = QString("v2 软件包条目超出数据区: %1").arg(entry.name);
+            return false;
+        }
+        entries.append(entry);
+        pos += nameLength + kBundleTocFixedSize;
+    }
+
+    return true;
+}
+
+bool ArchiveReader::readBundleEntry(QFile &file, const ArchiveEntry &entry,
+                                    const std::function<bool(const char *, qint64)> &sink) {
+    if (!file.seek(entry.offset)) {
+        errorMessage = QString("v2 软件包数据偏移无效: %1").arg(entry.name);
+        return false;
+    }
+
+    qint64 written = 0;
+    quint32 crc = 0;
+    bool ok = copyEntryData(file, entry, [&sink, &written](const char *data, qint64 size) {
+        written += size;
+        return sink(data, size);
+    }, crc);
+    if (!ok) {
+        return false;
+    }
+
+    if (written != entry.size) {
+        errorMessage = QString("v2 软件包条目大小不符: %1").arg(entry.name);
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveReader::copyEntryData(QFile &file, const ArchiveEntry &entry,
+                                  const std::function<bool(const char *, qint64)> &sink, quint32 &crc) {
+    if (entry.method != 0 && entry.method != 8) {
+        errorMessage = QString("不支持的压缩方法 %1: %2").arg(entry.method).arg(entry.name);
+        return false;
+    }
+
+    QByteArray input(kChunkSize, Qt::Uninitialized);
+    QByteArray output(kChunkSize, Qt::Uninitialized);
+    qint64 compressedLeft = entry.compressedSize;
+    uLong checksum = crc32(0L, Z_NULL, 0);
+
+    if (entry.method == 0) {
+        while (compressedLeft > 0) {
+            qint64 n = file.read(input.data(), qMin<qint64>(compressedLeft, input.size()));
+            if (n <= 0) {
+                errorMessage = QString("数据意外结束: %1").arg(entry.name);
+                return false;
+            }
+            checksum = crc32(checksum, reinterpret_cast<const Bytef *>(input.constData()), static_cast<uInt>(n));
+            if (!sink(input.constData(), n)) {
+                return false;
+            }
+            compressedLeft -= n;
+        }
+    } else {
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+            errorMessage = "初始化解压器失败";
+            return false;
+        }
+
+        int result = Z_OK;
+        while (result != Z_STREAM_END) {
+            if (stream.avail_in == 0 && compressedLeft > 0) {
+                qint64 n = file.read(input.data(), qMin<qint64>(compressedLeft, input.size()));
+                if (n <= 0) {
+                    break;
+                }
+                compressedLeft -= n;
+                stream.next_in = reinterpret_cast<Bytef *>(input.data());
+                stream.avail_in = static_cast<uInt>(n);
+            }
+
+            stream.next_out = reinterpret_cast<Bytef *>(output.data());
+            stream.avail_out = static_cast<uInt>(output.size());
+            // Truncated input surfaces as Z_BUF_ERROR here
+            result = inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END) {
+                break;
+            }
+
+            qint64 produced = output.size() - stream.avail_out;
+            checksum = crc32(checksum, reinterpret_cast<const Bytef *>(output.constData()), static_cast<uInt>(produced));
+            if (produced > 0 && !sink(output.constData(), produced)) {
+                inflateEnd(&stream);
+                return false;
+            }
+        }
+        inflateEnd(&stream);
+
+        if (result != Z_STREAM_END) {
+            errorMessage = QString("数据解压失败: %1").arg(entry.name);
+            return false;
+        }
+    }
+
+    crc = static_cast<quint32>(checksum);
+    return true;
+}
@@ -0,0 +1,167 @@
+#ifndef ARCHIVEREADER_H
+#define ARCHIVEREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QMap>
+#include <QList>
+#include <functional>
+#include <memory>
+
+class QFile;
+
+struct ArchiveEntry {
+    QString name;
+    qint64 size = 0;
+    qint64 compressedSize = 0;
+    qint64 offset = 0;      // Zip: offset of the local file header; bundle v2: of the data
+    int method = 0;         // Zip, bundle v2: compression method (0 stored, 8 deflate)
+    quint32 crc32 = 0;      // Zip: CRC-32 of the uncompressed data
+    QString digest;         // Bundle v2: SHA-256 of the uncompressed data, lowercase hex
+    bool isFile = false;
+    bool isDirectory = false;
+};
+
+// Callbacks for ArchiveReader::streamEntries(); returning false from
+// any of them stops the stream
+struct EntryStreamHandler {
+    std::function<bool(const ArchiveEntry &)> begin;
+    std::function<bool(const char *, qint64)> data;
+    std::function<bool(const ArchiveEntry &)> end;
+};
+
+// Bytes of one archive entry. Stored (uncompressed) entries of a v2
+// bundle are mapped from the archive in place; everything else is read
+// into memory. Copies share the data.
+class EntryData {
+public:
+    const char *data() const;
+    qint64 size() const;
+
+    // Whether the bytes are mapped from the archive file
+    bool isMapped() const;
+
+private:
+    friend class ArchiveReader;
+
+    std::shared_ptr<QFile> file;    // keeps the mapping alive
+    const char *mapped = nullptr;
+    qint64 length = 0;
+    QByteArray buffer;
+};
+
+// Sequential tar reader over an arbitrary byte source (e.g. a gzip stream).
+// Handles ustar prefixes, GNU long names, base-256 sizes and pax headers.
+class TarStream {
+public:
+    using ReadFunction = std::function<qint64(char *data, qint64 maxSize)>;
+
+    explicit TarStream(ReadFunction read);
+
+    // Advance to the next entry; returns false at end of archive or on error
+    bool next(ArchiveEntry &entry);
+
+    // Read data of the current entry
+    qint64 readData(char *data, qint64 maxSize);
+
+    // Skip the rest of the current entry
+    bool skipData();
+
+    bool hasError() const;
+    QString getErrorMessage() const;
+
+private:
+    bool readFully(char *data, qint64 size);
+    bool skipBytes(qint64 size);
+    bool readExtension(qint64 size, QByteArray &data);
+
+    ReadFunction read;
+    qint64 remaining;
+    qint64 padding;
+    bool failed;
+    QString errorMessage;
+};
+
+// In-process reader for tar.gz, zip and v2 bundles that pulls out single
+// entries without unpacking the rest of the archive to disk.
+//
+// A v2 bundle is a 16-byte header, independently compressed entries, a
+// table of contents and a fixed-size footer pointing at it (layout in
+// INTEGRATION_GUIDE.md). The footer and TOC come from one read of the
+// file's tail, so any entry is reached with two reads.
+class ArchiveReader {
+public:
+    enum class Format {
+        TarGz,
+        Zip,
+        BundleV2,
+        Unknown
+    };
+
+    explicit ArchiveReader(const QString &archivePath);
+
+    // Detect archive format from its magic bytes
+    Format getFormat() const;
+
+    // Largest entry readEntries() and mapEntries() copy into memory,
+    // capped at INT_MAX; larger entries fail instead of being truncated
+    void setMaxEntrySize(qint64 bytes);
+
+    // Read the named entries into memory; stops as soon as all are found.
+    // Entries missing from the archive are simply absent from contents.
+    bool readEntries(const QStringList &names, QMap<QString, QByteArray> &contents);
+
+    // Like readEntries(), but maps stored v2 bundle entries instead of
+    // copying them
+    bool mapEntries(const QStringList &names, QMap<QString, EntryData> &contents);
+
+    // Stream the named file entries through handler without buffering
+    // them: indexed archives deliver them in the order of names, tar.gz in
+    // archive order. Names missing from the archive are skipped.
+    bool streamEntries(const QStringList &names, const EntryStreamHandler &handler);
+
+    // Read the entry list of an indexed archive (zip or bundle v2)
+    bool readDirectory(QList<ArchiveEntry> &entries);
+
+    // Stream one entry of an indexed archive into sink
+    bool readEntry(QFile &file, const ArchiveEntry &entry,
+                   const std::function<bool(const char *, qint64)> &sink);
+
+    // Read the zip central directory
+    bool readZipDirectory(QList<ArchiveEntry> &entries);
+
+    // Stream one zip entry's uncompressed data into sink
+    bool readZipEntry(QFile &file, const ArchiveEntry &entry,
+                      const std::function<bool(const char *, qint64)> &sink);
+
+    // Read the table of contents of a v2 bundle
+    bool readBundleDirectory(QList<ArchiveEntry> &entries);
+
+    // Stream one v2 bundle entry's uncompressed data into sink; the
+    // caller checks the data against entry.digest
+    bool readBundleEntry(QFile &file, const ArchiveEntry &entry,
+                         const std::function<bool(const char *, qint64)> &sink);
+
+    // Get error message
+    QString getErrorMessage() const;
+
+    // Normalize an archive member name ("./a/b" -> "a/b")
+    static QString normalizeName(const QString &name);
+
+private:
+    bool checkEntrySize(const ArchiveEntry &entry);
+    bool readTarGzEntries(const QStringList &names, QMap<QString, QByteArray> &contents);
+    bool readIndexedEntries(const QStringList &names, QMap<QString, QByteArray> &contents);
+    bool streamTarGzEntries(const QStringList &names, const EntryStreamHandler &handler);
+    bool streamIndexedEntries(const QStringList &names, const EntryStreamHandler &handler);
+    bool copyEntryData(QFile &file, const ArchiveEntry &entry,
+                       const std::function<bool(const char *, qint64)> &sink, quint32 &crc);
+
+    QString archivePath;
+    Format format;
+    qint64 maxEntrySize;
+    QString errorMessage;
+};
+
+#endif // ARCHIVEREADER_H
@@ -0,0 +1,76 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QWaitCondition>
+
+// Blocking producer/consumer queue with a fixed capacity. Producers block
+// while it is full, which gives back-pressure between pipeline stages.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(int capacity)
+        : capacity(capacity)
+        , closed(false)
+    {
+    }
+
+    // Returns false if the queue was closed before the item could be queued
+    bool push(T item) {
+        QMutexLocker locker(&mutex);
+        while (items.size() >= capacity && !closed) {
+            notFull.wait(&mutex);
+        }
+        if (closed) {
+            return false;
+        }
+        items.enqueue(std::move(item));
+        notEmpty.wakeOne();
+        return true;
+    }
+
+    // Returns false once the queue is closed and drained
+    bool pop(T &item) {
+        QMutexLocker locker(&mutex);
+        while (items.isEmpty() && !closed) {
+            notEmpty.wait(&mutex);
+        }
+        if (items.isEmpty()) {
+            return false;
+        }
+        item = items.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    // Like pop(), but returns false at once if nothing is queued
+    bool tryPop(T &item) {
+        QMutexLocker locker(&mutex);
+        if (items.isEmpty()) {
+            return false;
+        }
+        item = items.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    // Wake all waiters; remaining items can still be popped
+    void close() {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+private:
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    QQueue<T> items;
+    int capacity;
+    bool closed;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -9,6 +9,12 @@
 #include <QFont>
 #include <QDateTime>
 
+namespace {
+
+const int kMaxLogEntries = 5000;
+
+} // namespace
+
 CompleteScreen::CompleteScreen(std::shared_ptr<Logger> logger, QWidget *parent)
     : QWidget(parent)
     , logger(logger)
@@ -33,10 +39,24 @@ void CompleteScreen::setInstallResult(bool success, const QString &packagePath)
     details += QString("软件包: %1\n").arg(packagePath);
     details += QString("状态: %1\n\n").arg(success ? "成功" : "失败");
 
-    // Get logs
-    QString logs = logger->getAllLogs();
+    // Only this session's records, and only the latest of them
+    LogQuery query;
+    query.session = logger->currentSession();
+    query.offset = -kMaxLogEntries;
+    query.limit = kMaxLogEntries;
+    LogPage page = logger->query(query);
+
     details += "安装日志:\n";
-    details += logs;
+    if (page.total > page.entries.size()) {
+        details += QString("(共 %1 条，仅显示最后 %2 条，完整日志见 %3)\n")
+            .arg(page.total).arg(page.entries.size()).arg(logger->getLogFilePath());
+    }
+    for (const LogEntry &entry : page.entries) {
+        details += QString("[%1] [%2] %3\n")
+            .arg(QDateTime::fromMSecsSinceEpoch(entry.timestamp).toString("hh:mm:ss"))
+            .arg(LogStore::levelName(entry.level))
+            .arg(entry.message);
+    }
 
     detailsOutput->setPlainText(details);
 }
@@ -0,0 +1,188 @@
+#include "debianversion.h"
+
+#include <QRegularExpression>
+#include <cstring>
+
+namespace {
+
+// Weights of characters in a non-digit run, following dpkg's order():
+// '~' < end of run < letters < everything else
+const quint16 kTildeWeight = 1;
+const quint16 kEndWeight = 2;
+
+void appendWeight(QByteArray &key, quint16 weight) {
+    key.append(static_cast<char>(weight >> 8));
+    key.append(static_cast<char>(weight & 0xff));
+}
+
+quint16 weightOf(uchar c) {
+    if (c == '~') {
+        return kTildeWeight;
+    }
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+        return kEndWeight + c;
+    }
+    return kEndWeight + 256 + c;
+}
+
+bool isDigit(uchar c) {
+    return c >= '0' && c <= '9';
+}
+
+// Alternate non-digit and digit runs as dpkg's verrevcmp() does. Numbers
+// are stored without leading zeros behind their length, so longer means
+// larger and equal lengths compare digit by digit.
+void appendPart(QByteArray &key, const QByteArray &part) {
+    int pos = 0;
+    const int size = part.size();
+
+    do {
+        while (pos < size && !isDigit(static_cast<uchar>(part[pos]))) {
+            appendWeight(key, weightOf(static_cast<uchar>(part[pos])));
+            ++pos;
+        }
+        appendWeight(key, kEndWeight);
+
+        while (pos < size && part[pos] == '0') {
+            ++pos;
+        }
+        int start = pos;
+        while (pos < size && isDigit(static_cast<uchar>(part[pos]))) {
+            ++pos;
+        }
+        int length = qMin(pos - start, 255);
+        key.append(static_cast<char>(length));
+        key.append(part.constData() + start, length);
+    } while (pos < size);
+
+    appendWeight(key, kEndWeight);
+}
+
+} // namespace
+
+QByteArray DebianVersion::sortKey(const QString &version) {
+    QByteArray text = version.trimmed().toUtf8();
+
+    quint32 epoch = 0;
+    int colon = text.indexOf(':');
+    if (colon > 0) {
+        bool ok = false;
+        epoch = text.left(colon).toUInt(&ok);
+        if (!ok) {
+            epoch = 0;
+        }
+        text = text.mid(colon + 1);
+    }
+
+    int dash = text.lastIndexOf('-');
+    QByteArray upstream = dash >= 0 ? text.left(dash) : text;
+    QByteArray revision = dash >= 0 ? text.mid(dash + 1) : QByteArray();
+
+    QByteArray key;
+    key.reserve(8 + 2 * text.size() + 16);
+    key.append(static_cast<char>(epoch >> 24));
+    key.append(static_cast<char>(epoch >> 16));
+    key.append(static_cast<char>(epoch >> 8));
+    key.append(static_cast<char>(epoch));
+    appendPart(key, upstream);
+    appendPart(key, revision);
+    return key;
+}
+
+int DebianVersion::compare(const QString &a, const QString &b) {
+    return compareKeys(sortKey(a), sortKey(b));
+}
+
+int DebianVersion::compareKeys(const QByteArray &a, const QByteArray &b) {
+    int common = qMin(a.size(), b.size());
+    int result = memcmp(a.constData(), b.constData(), static_cast<size_t>(common));
+    if (result != 0) {
+        return result;
+    }
+    return a.size() - b.size();
+}
+
+const QByteArray &VersionKeyCache::key(const QString &version) {
+    auto it = keys.find(version);
+    if (it == keys.end()) {
+        it = keys.insert(version, DebianVersion::sortKey(version));
+    }
+    return it.value();
+}
+
+int VersionKeyCache::compare(const QString &a, const QString &b) {
+    // Copy the first key: inserting the second may rehash
+    QByteArray first = key(a);
+    return DebianVersion::compareKeys(first, key(b));
+}
+
+bool VersionConstraint::satisfiedBy(const QString &candidate, VersionKeyCache &cache) const {
+    if (op == Any) {
+        return true;
+    }
+    if (candidate.isEmpty()) {
+        return false;
+    }
+
+    int result = cache.compare(candidate, version);
+    switch (op) {
+    case Less:
+        return result < 0;
+    case LessEqual:
+        return result <= 0;
+    case Equal:
+        return result == 0;
+    case GreaterEqual:
+        return result >= 0;
+    case Greater:
+        return result > 0;
+    default:
+        return true;
+    }
+}
+
+QString VersionConstraint::toString() const {
+    static const char *const names[] = { "", "<<", "<=", "=", ">=", ">>" };
+    if (op == Any) {
+        return name;
+    }
+    return QString("%1 (%2 %3)").arg(name, names[op], version);
+}
+
+bool parseRelation(const QString &text, DependencyAlternatives &alternatives) {
+    // name[:arch] [(op version)]
+    static const QRegularExpression pattern(
+        "^\\s*([A-Za-z0-9][A-Za-z0-9+.\\-]*)(?::[A-Za-z0-9\\-]+)?\\s*"
+        "(?:\\(\\s*(<<|<=|=|>=|>>|<|>)\\s*([^\\s)]+)\\s*\\))?\\s*$");
+
+    alternatives.clear();
+    for (const QString &term : text.split('|')) {
+        QRegularExpressionMatch match = pattern.match(term);
+        if (!match.hasMatch()) {
+            alternatives.clear();
+            return false;
+        }
+
+        VersionConstraint constraint;
+        constraint.name = match.captured(1);
+        QString op = match.captured(2);
+        if (!op.isEmpty()) {
+            constraint.version = match.captured(3);
+            // "<" and ">" are obsolete spellings of "<=" and ">="
+            if (op == "<<") {
+                constraint.op = VersionConstraint::Less;
+            } else if (op == "<=" || op == "<") {
+                constraint.op = VersionConstraint::LessEqual;
+            } else if (op == "=") {
+                constraint.op = VersionConstraint::Equal;
+            } else if (op == ">=" || op == ">") {
+                constraint.op = VersionConstraint::GreaterEqual;
+            } else {
+                constraint.op = VersionConstraint::Greater;
+            }
+        }
+        alternatives.append(constraint);
+    }
+
+    return !alternatives.isEmpty();
+}
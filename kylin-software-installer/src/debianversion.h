@@ -0,0 +1,65 @@
+#ifndef DEBIANVERSION_H
+#define DEBIANVERSION_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+
+// Debian version ordering ([epoch:]upstream[-revision], with '~' sorting
+// before everything, even the end of the string).
+//
+// Versions are compiled into sort keys whose byte order is the Debian
+// order, so once a key is built a comparison is a single memcmp.
+class DebianVersion {
+public:
+    // Build the sort key for a version string
+    static QByteArray sortKey(const QString &version);
+
+    // Compare two versions: <0, 0 or >0
+    static int compare(const QString &a, const QString &b);
+
+    // Compare two keys built by sortKey()
+    static int compareKeys(const QByteArray &a, const QByteArray &b);
+};
+
+// Memoizes sort keys so every version string is parsed once per solve
+class VersionKeyCache {
+public:
+    const QByteArray &key(const QString &version);
+
+    int compare(const QString &a, const QString &b);
+
+private:
+    QHash<QString, QByteArray> keys;
+};
+
+// One "name (op version)" term of a dependency relation
+struct VersionConstraint {
+    enum Operator {
+        Any,            // no version given
+        Less,           // <<
+        LessEqual,      // <=
+        Equal,          // =
+        GreaterEqual,   // >=
+        Greater         // >>
+    };
+
+    QString name;
+    Operator op = Any;
+    QString version;
+
+    // Check a concrete version against the constraint
+    bool satisfiedBy(const QString &candidate, VersionKeyCache &cache) const;
+
+    // Format back to Debian syntax
+    QString toString() const;
+};
+
+// Alternatives of one relation ("a (>= 1) | b"); any one satisfies it
+typedef QList<VersionConstraint> DependencyAlternatives;
+
+// Parse a relation; false if it is malformed
+bool parseRelation(const QString &text, DependencyAlternatives &alternatives);
+
+#endif // DEBIANVERSION_H
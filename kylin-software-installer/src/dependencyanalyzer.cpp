@@ -1,180 +1,326 @@
 #include "dependencyanalyzer.h"
 #include "logger.h"
+#include "installedpackageindex.h"
+#include "dependencygraph.h"
 
-#include <QProcess>
-#include <QSet>
-#include <algorithm>
+#include <QElapsedTimer>
+#include <QSettings>
 
 DependencyAnalyzer::DependencyAnalyzer(std::shared_ptr<Logger> logger)
     : logger(logger)
+    , installedIndex(InstalledPackageIndex::instance(logger))
 {
 }
 
-QStringList DependencyAnalyzer::getInstallationOrder(const QStringList &packages,
-                                                      const QMap<QString, QStringList> &dependencies) {
-    logger->info("开始分析安装顺序");
+ResolvedDependencies DependencyAnalyzer::resolveConstraints(const PackageTable &bundle,
+                                                            const QMap<QString, QStringList> &relations,
+                                                            const QMap<QString, QStringList> &provides) {
+    QElapsedTimer timer;
+    timer.start();
     
-    // Check for circular dependencies
-    if (hasCyclicDependency(dependencies)) {
-        errorMessage = "检测到循环依赖";
-        logger->error(errorMessage);
-        return QStringList();
+    ResolvedDependencies result;
+    
+    for (int row = 0; row < bundle.size(); ++row) {
+        result.versions.insert(bundle.name(row), bundle.version(row));
     }
     
-    // Get all packages including dependencies
-    QSet<QString> allPackages;
-    for (const QString &pkg : packages) {
-        allPackages.insert(pkg);
-        QStringList deps = getAllDependencies(pkg, dependencies);
-        for (const QString &dep : deps) {
-            allPackages.insert(dep);
+    // Virtual package name -> bundled packages providing it
+    QHash<QString, QList<Provider>> providers;
+    DependencyAlternatives alternatives;
+    for (auto it = provides.constBegin(); it != provides.constEnd(); ++it) {
+        for (const QString &text : it.value()) {
+            if (!parseRelation(text, alternatives)) {
+                logger->warning(QString("无法解析虚拟包声明: %1 -> %2").arg(it.key(), text));
+                continue;
+            }
+            const VersionConstraint &virtualPackage = alternatives.first();
+            Provider provider;
+            provider.package = it.key();
+            if (virtualPackage.op == VersionConstraint::Equal) {
+                provider.version = virtualPackage.version;
+            }
+            providers[virtualPackage.name].append(provider);
         }
     }
     
-    // Topological sort
-    QSet<QString> visited;
-    QStringList result;
-    for (const QString &pkg : allPackages) {
-        if (!visited.contains(pkg)) {
-            topologicalSortHelper(pkg, visited, result, dependencies);
+    int relationCount = 0;
+    for (auto it = relations.constBegin(); it != relations.constEnd(); ++it) {
+        QStringList chosen;
+        for (const QString &text : it.value()) {
+            if (!parseRelation(text, alternatives)) {
+                logger->warning(QString("无法解析依赖关系: %1 -> %2").arg(it.key(), text));
+                continue;
+            }
+            relationCount++;
+            
+            QString choice = chooseAlternative(alternatives, result.versions, providers);
+            if (choice.isEmpty()) {
+                // Keep the first alternative in the graph so it is still shown
+                result.unsatisfied.append(QString("%1: %2").arg(it.key(), text));
+                choice = alternatives.first().name;
+            }
+            if (choice == it.key()) {
+                continue;
+            }
+            if (!chosen.contains(choice)) {
+                chosen.append(choice);
+            }
+            // A virtual package's version says nothing about its provider's
+            for (const VersionConstraint &alternative : alternatives) {
+                if (alternative.name == choice && alternative.op != VersionConstraint::Any) {
+                    result.constraints[it.key()].append(alternative);
+                }
+            }
         }
+        result.edges.insert(it.key(), chosen);
     }
     
-    logger->info(QString("安装顺序: %1").arg(result.join(", ")));
+    for (const QString &problem : result.unsatisfied) {
+        logger->warning(QString("依赖版本无法满足: %1").arg(problem));
+    }
+    logger->info(QString("版本约束检查完成: %1 条依赖，%2 条无法满足，耗时 %3 ms")
+                 .arg(relationCount).arg(result.unsatisfied.size()).arg(timer.elapsed()));
     return result;
 }
 
-bool DependencyAnalyzer::isPackageInstalled(const QString &packageName) {
-    // Try dpkg first (Debian/Ubuntu)
-    QProcess process;
-    process.start("dpkg", QStringList() << "-l" << packageName);
-    if (process.waitForFinished()) {
-        if (process.exitCode() == 0) {
-            return true;
+InstallPlan DependencyAnalyzer::planInstallation(const QStringList &packages,
+                                                 const ResolvedDependencies &resolved) {
+    InstallPlan plan;
+    DependencyGraph graph(resolved.edges, packages);
+    QVector<quint32> roots = graph.idsOf(packages);
+    
+    NodeSet needed(graph.nodeCount());
+    QVector<quint32> stack;
+    QSettings settings("Kylin", "SoftwareInstaller");
+    bool upgradeBundled = settings.value("install/upgradeBundled", false).toBool();
+    
+    // Check one node reached from dependent (empty for a root), queueing
+    // it for traversal when it must be installed. A satisfied node may be
+    // reached again from another dependent with a stricter constraint.
+    auto visit = [&](quint32 id, const QString &dependent) {
+        if (needed.contains(id)) {
+            return;
+        }
+        
+        const QString &name = graph.name(id);
+        QString installed = installedIndex->installedVersion(name);
+        if (!installed.isEmpty()) {
+            bool satisfied = true;
+            for (const VersionConstraint &constraint : resolved.constraints.value(dependent)) {
+                if (constraint.name == name && !constraint.satisfiedBy(installed, versionKeys)) {
+                    satisfied = false;
+                    break;
+                }
+            }
+            
+            auto bundled = resolved.versions.constFind(name);
+            bool newer = bundled != resolved.versions.constEnd()
+                    && versionKeys.compare(installed, bundled.value()) < 0;
+            if (satisfied && !(upgradeBundled && newer)) {
+                return;
+            }
+            plan.upgrade.append(name);
+        }
+        needed.insert(id);
+        stack.append(id);
+    };
+    
+    // Dependencies of a satisfied package were satisfied when it was
+    // installed, so its subtree is only entered through needed packages
+    for (quint32 root : roots) {
+        visit(root, QString());
+    }
+    while (!stack.isEmpty()) {
+        quint32 node = stack.takeLast();
+        for (const quint32 *dep = graph.dependenciesBegin(node); dep != graph.dependenciesEnd(node); ++dep) {
+            visit(*dep, graph.name(node));
         }
     }
     
-    // Try rpm (RedHat/CentOS)
-    process.start("rpm", QStringList() << "-q" << packageName);
-    if (process.waitForFinished()) {
-        if (process.exitCode() == 0) {
-            return true;
+    for (quint32 id : graph.closure(roots)) {
+        const QString &name = graph.name(id);
+        if (!needed.contains(id)) {
+            plan.skipped.append(name);
+            continue;
         }
+        
+        plan.install.append(name);
+        QStringList deps;
+        for (const quint32 *dep = graph.dependenciesBegin(id); dep != graph.dependenciesEnd(id); ++dep) {
+            if (needed.contains(*dep)) {
+                deps.append(graph.name(*dep));
+            }
+        }
+        plan.dependencies.insert(name, deps);
     }
     
-    return false;
+    logger->info(QString("安装计划: %1 个需要安装（其中 %2 个升级），%3 个已满足")
+                 .arg(plan.install.size()).arg(plan.upgrade.size()).arg(plan.skipped.size()));
+    return plan;
 }
 
-QStringList DependencyAnalyzer::getAllDependencies(const QString &package,
-                                                    const QMap<QString, QStringList> &dependencies) {
-    QStringList result;
-    QSet<QString> visited;
+QStringList DependencyAnalyzer::getInstallationOrder(const QStringList &packages,
+                                                      const QMap<QString, QStringList> &dependencies) {
+    logger->info("开始分析安装顺序");
     
-    std::function<void(const QString &)> dfs = [&](const QString &pkg) {
-        if (visited.contains(pkg)) {
-            return;
-        }
-        visited.insert(pkg);
+    // Closure, cycle check and ordering in a single pass
+    DependencyGraph graph(dependencies, packages);
+    QVector<quint32> roots = graph.idsOf(packages);
+    QVector<quint32> order;
+    QVector<quint32> cycle;
+    if (!graph.resolve(roots, order, cycle)) {
+        // Install each cycle as one unit, in condensed order
+        logger->warning(QString("检测到循环依赖: %1，将作为一个整体安装")
+                        .arg(graph.namesOf(cycle).join(" -> ")));
         
-        if (dependencies.contains(pkg)) {
-            for (const QString &dep : dependencies.value(pkg)) {
-                result.append(dep);
-                dfs(dep);
-            }
+        QVector<QVector<quint32>> units;
+        QVector<int> unitLevels;
+        graph.condense(roots, units, unitLevels);
+        order.clear();
+        for (const QVector<quint32> &unit : units) {
+            order += unit;
         }
-    };
+    }
     
-    dfs(package);
+    QStringList result = graph.namesOf(order);
+    
+    logger->info(QString("安装顺序: %1").arg(result.join(", ")));
     return result;
 }
 
-bool DependencyAnalyzer::hasCyclicDependency(const QMap<QString, QStringList> &dependencies) {
-    QSet<QString> visited;
-    QSet<QString> recursionStack;
-    
-    for (const QString &node : dependencies.keys()) {
-        if (!visited.contains(node)) {
-            if (hasCyclicDependencyHelper(node, visited, recursionStack, dependencies)) {
-                return true;
-            }
+QList<QStringList> DependencyAnalyzer::getInstallationLevels(const QStringList &packages,
+                                                             const QMap<QString, QStringList> &dependencies) {
+    logger->info("开始计算分层安装计划");
+
+    // Cycles are condensed into units, so a plan always exists
+    DependencyGraph graph(dependencies, packages);
+    QVector<QVector<quint32>> units;
+    QVector<int> unitLevels;
+    graph.condense(graph.idsOf(packages), units, unitLevels);
+
+    QList<QStringList> result;
+    int placed = 0;
+    for (int i = 0; i < units.size(); ++i) {
+        while (result.size() <= unitLevels[i]) {
+            result.append(QStringList());
+        }
+
+        QStringList names = graph.namesOf(units[i]);
+        if (names.size() > 1) {
+            names.sort();
+            logger->warning(QString("循环依赖将在同一事务中安装: %1").arg(names.join(", ")));
         }
+        result[unitLevels[i]].append(names);
+        placed += names.size();
+    }
+    for (QStringList &level : result) {
+        level.sort();
+    }
+
+    logger->info(QString("分层安装计划: %1 个软件包，%2 层").arg(placed).arg(result.size()));
+    return result;
+}
+
+QList<QStringList> DependencyAnalyzer::getInstallationUnits(const QStringList &packages,
+                                                            const QMap<QString, QStringList> &dependencies) {
+    DependencyGraph graph(dependencies, packages);
+    QVector<QVector<quint32>> units;
+    QVector<int> unitLevels;
+    graph.condense(graph.idsOf(packages), units, unitLevels);
+
+    QList<QStringList> result;
+    result.reserve(units.size());
+    for (const QVector<quint32> &unit : units) {
+        // Cycles are logged by getInstallationLevels(), not again here
+        QStringList names = graph.namesOf(unit);
+        names.sort();
+        result.append(names);
     }
+    return result;
+}
+
+bool DependencyAnalyzer::isPackageInstalled(const QString &packageName) {
+    return installedIndex->isInstalled(packageName);
+}
+
+QStringList DependencyAnalyzer::getAllDependencies(const QString &package,
+                                                    const QMap<QString, QStringList> &dependencies) {
+    DependencyGraph graph(dependencies, QStringList() << package);
+    QVector<quint32> nodes = graph.closure(graph.idsOf(QStringList() << package));
     
-    return false;
+    // The first node is the package itself
+    nodes.removeFirst();
+    return graph.namesOf(nodes);
+}
+
+bool DependencyAnalyzer::hasCyclicDependency(const QMap<QString, QStringList> &dependencies) {
+    return DependencyGraph(dependencies).hasCycle();
 }
 
 QMap<QString, DependencyNode> DependencyAnalyzer::buildDependencyTree(
     const QStringList &packages,
-    const QMap<QString, QStringList> &dependencies) {
+    const QMap<QString, QStringList> &dependencies,
+    const QMap<QString, QString> &versions) {
     
-    QMap<QString, DependencyNode> tree;
+    QElapsedTimer timer;
+    timer.start();
     
-    std::function<void(const QString &, int)> buildTree = [&](const QString &pkg, int level) {
-        if (tree.contains(pkg)) {
-            return;
-        }
-        
+    DependencyGraph graph(dependencies, packages);
+    QVector<quint32> roots = graph.idsOf(packages);
+    QVector<int> depths = graph.depths(roots);
+    
+    QMap<QString, DependencyNode> tree;
+    for (quint32 id : graph.closure(roots)) {
         DependencyNode node;
-        node.name = pkg;
-        node.installed = isPackageInstalled(pkg);
-        node.dependencies = dependencies.value(pkg, QStringList());
-        node.level = level;
-        
-        tree[pkg] = node;
-        
-        for (const QString &dep : node.dependencies) {
-            buildTree(dep, level + 1);
+        node.name = graph.name(id);
+        node.installed = isPackageInstalled(node.name);
+        node.version = node.installed ? installedIndex->installedVersion(node.name)
+                                      : versions.value(node.name);
+        for (const quint32 *dep = graph.dependenciesBegin(id); dep != graph.dependenciesEnd(id); ++dep) {
+            node.dependencies.append(graph.name(*dep));
         }
-    };
-    
-    for (const QString &pkg : packages) {
-        buildTree(pkg, 0);
+        node.level = depths[static_cast<int>(id)];
+        tree.insert(node.name, node);
     }
     
-    logger->info(QString("依赖树构建完成，共 %1 个节点").arg(tree.size()));
+    logger->info(QString("依赖树构建完成，共 %1 个节点，%2 条依赖，耗时 %3 ms")
+                 .arg(tree.size()).arg(graph.edgeCount()).arg(timer.elapsed()));
     return tree;
 }
 
-QString DependencyAnalyzer::getErrorMessage() const {
-    return errorMessage;
-}
-
-bool DependencyAnalyzer::hasCyclicDependencyHelper(const QString &node,
-                                                    QSet<QString> &visited,
-                                                    QSet<QString> &recursionStack,
-                                                    const QMap<QString, QStringList> &dependencies) {
-    visited.insert(node);
-    recursionStack.insert(node);
-    
-    if (dependencies.contains(node)) {
-        for (const QString &neighbor : dependencies.value(node)) {
-            if (!visited.contains(neighbor)) {
-                if (hasCyclicDependencyHelper(neighbor, visited, recursionStack, dependencies)) {
-                    return true;
-                }
-            } else if (recursionStack.contains(neighbor)) {
-                return true;
-            }
+QString DependencyAnalyzer::chooseAlternative(const DependencyAlternatives &alternatives,
+                                              const QMap<QString, QString> &bundleVersions,
+                                              const QHash<QString, QList<Provider>> &providers) {
+    // Prefer what is already installed, so nothing is replaced needlessly
+    for (const VersionConstraint &alternative : alternatives) {
+        QString installed = installedIndex->installedVersion(alternative.name);
+        if (!installed.isEmpty() && alternative.satisfiedBy(installed, versionKeys)) {
+            return alternative.name;
         }
     }
     
-    recursionStack.remove(node);
-    return false;
-}
-
-void DependencyAnalyzer::topologicalSortHelper(const QString &node,
-                                               QSet<QString> &visited,
-                                               QStringList &result,
-                                               const QMap<QString, QStringList> &dependencies) {
-    visited.insert(node);
-    
-    if (dependencies.contains(node)) {
-        for (const QString &neighbor : dependencies.value(node)) {
-            if (!visited.contains(neighbor)) {
-                topologicalSortHelper(neighbor, visited, result, dependencies);
+    // Then what the bundle ships, real packages before virtual ones
+    for (const VersionConstraint &alternative : alternatives) {
+        auto bundled = bundleVersions.constFind(alternative.name);
+        if (bundled != bundleVersions.constEnd() && alternative.satisfiedBy(bundled.value(), versionKeys)) {
+            return alternative.name;
+        }
+        // An unversioned Provides only satisfies an unversioned relation
+        for (const Provider &provider : providers.value(alternative.name)) {
+            if (alternative.op == VersionConstraint::Any
+                    || (!provider.version.isEmpty() && alternative.satisfiedBy(provider.version, versionKeys))) {
+                return provider.package;
             }
         }
     }
     
-    result.append(node);
+    // Packages unknown here are left to the package manager's repositories
+    for (const VersionConstraint &alternative : alternatives) {
+        if (!bundleVersions.contains(alternative.name) && !providers.contains(alternative.name)
+                && !installedIndex->isInstalled(alternative.name)) {
+            return alternative.name;
+        }
+    }
+    
+    return QString();
 }
@@ -1,27 +1,74 @@
 #ifndef DEPENDENCYANALYZER_H
 #define DEPENDENCYANALYZER_H
 
+#include "packageparser.h"
+#include "debianversion.h"
+
 #include <QString>
 #include <QStringList>
 #include <QMap>
+#include <QHash>
 #include <memory>
 
 class Logger;
+class InstalledPackageIndex;
 
 struct DependencyNode {
     QString name;
+    QString version;    // installed version, or the bundled one
     bool installed;
     QStringList dependencies;
     int level;
 };
 
+// Versioned relations resolved to concrete packages
+struct ResolvedDependencies {
+    QMap<QString, QStringList> edges;       // chosen package per relation
+    QMap<QString, DependencyAlternatives> constraints;  // versioned edges, per dependent
+    QMap<QString, QString> versions;        // bundled package versions
+    QStringList unsatisfied;                // relations no candidate meets
+};
+
+// The part of a bundle that actually has to be installed
+struct InstallPlan {
+    QStringList install;                        // packages to install or upgrade
+    QStringList upgrade;                        // of those, present at an older version
+    QStringList skipped;                        // already satisfied
+    QMap<QString, QStringList> dependencies;    // edges among install only
+};
+
 class DependencyAnalyzer {
 public:
     explicit DependencyAnalyzer(std::shared_ptr<Logger> logger);
 
-    // Analyze dependencies and return installation order
+    // Pick one package for every relation in dependencies.json, checking
+    // version constraints against the bundle (including its Provides) and
+    // the installed index. The resulting name map feeds the methods below.
+    ResolvedDependencies resolveConstraints(const PackageTable &bundle,
+                                            const QMap<QString, QStringList> &relations,
+                                            const QMap<QString, QStringList> &provides);
+
+    // Drop packages the system already satisfies, along with dependencies
+    // only they need. An installed package is kept only when a needed
+    // dependent's constraint rejects its version, or, with the
+    // install/upgradeBundled setting, when the bundle ships a newer one
+    InstallPlan planInstallation(const QStringList &packages, const ResolvedDependencies &resolved);
+
+    // Analyze dependencies and return installation order; members of a
+    // dependency cycle are placed next to each other
     QStringList getInstallationOrder(const QStringList &packages,
                                      const QMap<QString, QStringList> &dependencies);
+
+    // Group packages into levels: every package depends only on packages
+    // in earlier levels or in its own dependency cycle, so the members of
+    // one level can be installed together
+    QList<QStringList> getInstallationLevels(const QStringList &packages,
+                                             const QMap<QString, QStringList> &dependencies);
+
+    // Group packages into units in installation order: a unit is one
+    // package, or a whole dependency cycle, and depends only on earlier units
+    QList<QStringList> getInstallationUnits(const QStringList &packages,
+                                            const QMap<QString, QStringList> &dependencies);
     
     // Check if package is installed on system
     bool isPackageInstalled(const QString &packageName);
@@ -33,27 +80,25 @@ public:
     // Check for circular dependencies
     bool hasCyclicDependency(const QMap<QString, QStringList> &dependencies);
     
-    // Build dependency tree
+    // Build dependency tree; versions are shown for packages not installed
     QMap<QString, DependencyNode> buildDependencyTree(
         const QStringList &packages,
-        const QMap<QString, QStringList> &dependencies);
-    
-    // Get error message
-    QString getErrorMessage() const;
+        const QMap<QString, QStringList> &dependencies,
+        const QMap<QString, QString> &versions = QMap<QString, QString>());
 
 private:
-    bool hasCyclicDependencyHelper(const QString &node,
-                                   QSet<QString> &visited,
-                                   QSet<QString> &recursionStack,
-                                   const QMap<QString, QStringList> &dependencies);
-    
-    void topologicalSortHelper(const QString &node,
-                               QSet<QString> &visited,
-                               QStringList &result,
-                               const QMap<QString, QStringList> &dependencies);
+    struct Provider {
+        QString package;
+        QString version;    // empty for an unversioned Provides
+    };
+
+    QString chooseAlternative(const DependencyAlternatives &alternatives,
+                              const QMap<QString, QString> &bundleVersions,
+                              const QHash<QString, QList<Provider>> &providers);
 
     std::shared_ptr<Logger> logger;
-    QString errorMessage;
+    std::shared_ptr<InstalledPackageIndex> installedIndex;
+    VersionKeyCache versionKeys;
 };
 
 #endif // DEPENDENCYANALYZER_H
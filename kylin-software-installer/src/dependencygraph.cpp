@@ -0,0 +1,333 @@
+#include "dependencygraph.h"
+
+#include <QPair>
+#include <algorithm>
+
+namespace {
+
+// DFS frame: node and the next edge to follow
+typedef QPair<quint32, quint32> Frame;
+
+} // namespace
+
+DependencyGraph::DependencyGraph(const QMap<QString, QStringList> &dependencies,
+                                 const QStringList &extraNames) {
+    int edgeTotal = 0;
+    for (auto it = dependencies.constBegin(); it != dependencies.constEnd(); ++it) {
+        edgeTotal += it.value().size();
+    }
+
+    ids.reserve(dependencies.size() + extraNames.size());
+    names.reserve(dependencies.size() + extraNames.size());
+
+    // Keys first, so key i has id i and its row can be filled in map order
+    for (auto it = dependencies.constBegin(); it != dependencies.constEnd(); ++it) {
+        intern(it.key());
+    }
+    for (auto it = dependencies.constBegin(); it != dependencies.constEnd(); ++it) {
+        for (const QString &dep : it.value()) {
+            intern(dep);
+        }
+    }
+    for (const QString &name : extraNames) {
+        intern(name);
+    }
+
+    offsets.reserve(names.size() + 1);
+    edges.reserve(edgeTotal);
+    offsets.append(0);
+
+    quint32 id = 0;
+    for (auto it = dependencies.constBegin(); it != dependencies.constEnd(); ++it, ++id) {
+        int rowStart = edges.size();
+        for (const QString &dep : it.value()) {
+            quint32 target = ids.value(dep);
+            // A package trivially satisfies itself
+            if (target != id) {
+                edges.append(target);
+            }
+        }
+
+        // Drop duplicate edges
+        quint32 *begin = edges.data() + rowStart;
+        quint32 *end = edges.data() + edges.size();
+        std::sort(begin, end);
+        edges.resize(static_cast<int>(std::unique(begin, end) - edges.data()));
+        offsets.append(static_cast<quint32>(edges.size()));
+    }
+
+    // Nodes that only appear as dependencies have no row
+    while (offsets.size() < names.size() + 1) {
+        offsets.append(static_cast<quint32>(edges.size()));
+    }
+}
+
+int DependencyGraph::nodeCount() const {
+    return names.size();
+}
+
+int DependencyGraph::edgeCount() const {
+    return edges.size();
+}
+
+quint32 DependencyGraph::find(const QString &name) const {
+    return ids.value(name, InvalidId);
+}
+
+const QString &DependencyGraph::name(quint32 id) const {
+    return names[static_cast<int>(id)];
+}
+
+QVector<quint32> DependencyGraph::idsOf(const QStringList &list) const {
+    QVector<quint32> result;
+    result.reserve(list.size());
+    for (const QString &name : list) {
+        quint32 id = find(name);
+        if (id != InvalidId) {
+            result.append(id);
+        }
+    }
+    return result;
+}
+
+QStringList DependencyGraph::namesOf(const QVector<quint32> &list) const {
+    QStringList result;
+    result.reserve(list.size());
+    for (quint32 id : list) {
+        result.append(name(id));
+    }
+    return result;
+}
+
+const quint32 *DependencyGraph::dependenciesBegin(quint32 id) const {
+    return edges.constData() + offsets[static_cast<int>(id)];
+}
+
+const quint32 *DependencyGraph::dependenciesEnd(quint32 id) const {
+    return edges.constData() + offsets[static_cast<int>(id) + 1];
+}
+
+bool DependencyGraph::hasCycle() const {
+    NodeSet done(nodeCount());
+    NodeSet onStack(nodeCount());
+    QVector<Frame> stack;
+
+    for (quint32 start = 0; start < static_cast<quint32>(nodeCount()); ++start) {
+        if (done.contains(start)) {
+            continue;
+        }
+
+        onStack.insert(start);
+        stack.append(Frame(start, offsets[start]));
+        while (!stack.isEmpty()) {
+            Frame &top = stack.last();
+            if (top.second < offsets[top.first + 1]) {
+                quint32 next = edges[top.second++];
+                if (onStack.contains(next)) {
+                    return true;
+                }
+                if (!done.contains(next)) {
+                    onStack.insert(next);
+                    stack.append(Frame(next, offsets[next]));
+                }
+            } else {
+                onStack.remove(top.first);
+                done.insert(top.first);
+                stack.removeLast();
+            }
+        }
+    }
+
+    return false;
+}
+
+QVector<quint32> DependencyGraph::closure(const QVector<quint32> &roots) const {
+    NodeSet visited(nodeCount());
+    QVector<quint32> result;
+    QVector<quint32> stack;
+
+    for (quint32 root : roots) {
+        if (visited.contains(root)) {
+            continue;
+        }
+        visited.insert(root);
+        stack.append(root);
+
+        while (!stack.isEmpty()) {
+            quint32 node = stack.takeLast();
+            result.append(node);
+            for (const quint32 *dep = dependenciesBegin(node); dep != dependenciesEnd(node); ++dep) {
+                if (!visited.contains(*dep)) {
+                    visited.insert(*dep);
+                    stack.append(*dep);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+bool DependencyGraph::resolve(const QVector<quint32> &roots, QVector<quint32> &order,
+                              QVector<quint32> &cycle) const {
+    order.clear();
+    cycle.clear();
+    order.reserve(nodeCount());
+
+    NodeSet visited(nodeCount());
+    NodeSet onStack(nodeCount());
+    QVector<Frame> stack;
+
+    for (quint32 root : roots) {
+        if (visited.contains(root)) {
+            continue;
+        }
+        visited.insert(root);
+        onStack.insert(root);
+        stack.append(Frame(root, offsets[root]));
+
+        // Post-order: a node is emitted once all its dependencies are
+        while (!stack.isEmpty()) {
+            Frame &top = stack.last();
+            if (top.second < offsets[top.first + 1]) {
+                quint32 next = edges[top.second++];
+                if (onStack.contains(next)) {
+                    // The path from next's frame to the top closes the cycle
+                    int start = stack.size() - 1;
+                    while (stack[start].first != next) {
+                        --start;
+                    }
+                    for (int i = start; i < stack.size(); ++i) {
+                        cycle.append(stack[i].first);
+                    }
+                    cycle.append(next);
+                    return false;
+                }
+                if (!visited.contains(next)) {
+                    visited.insert(next);
+                    onStack.insert(next);
+                    stack.append(Frame(next, offsets[next]));
+                }
+            } else {
+                onStack.remove(top.first);
+                order.append(top.first);
+                stack.removeLast();
+            }
+        }
+    }
+
+    return true;
+}
+
+QVector<int> DependencyGraph::depths(const QVector<quint32> &roots) const {
+    QVector<int> result(nodeCount(), -1);
+    QVector<quint32> queue;
+    queue.reserve(nodeCount());
+
+    for (quint32 root : roots) {
+        if (result[root] < 0) {
+            result[root] = 0;
+            queue.append(root);
+        }
+    }
+
+    for (int head = 0; head < queue.size(); ++head) {
+        quint32 node = queue[head];
+        for (const quint32 *dep = dependenciesBegin(node); dep != dependenciesEnd(node); ++dep) {
+            if (result[*dep] < 0) {
+                result[*dep] = result[node] + 1;
+                queue.append(*dep);
+            }
+        }
+    }
+
+    return result;
+}
+
+void DependencyGraph::condense(const QVector<quint32> &roots, QVector<QVector<quint32>> &units,
+                               QVector<int> &unitLevels) const {
+    units.clear();
+    unitLevels.clear();
+
+    QVector<int> index(nodeCount(), -1);
+    QVector<int> low(nodeCount(), 0);
+    QVector<int> componentOf(nodeCount(), -1);
+    NodeSet onStack(nodeCount());
+    QVector<quint32> members;
+    QVector<Frame> stack;
+    int counter = 0;
+
+    auto enter = [&](quint32 node) {
+        index[node] = low[node] = counter++;
+        members.append(node);
+        onStack.insert(node);
+        stack.append(Frame(node, offsets[node]));
+    };
+
+    for (quint32 root : roots) {
+        if (index[root] >= 0) {
+            continue;
+        }
+        enter(root);
+
+        while (!stack.isEmpty()) {
+            Frame &top = stack.last();
+            quint32 node = top.first;
+            if (top.second < offsets[node + 1]) {
+                quint32 next = edges[top.second++];
+                if (index[next] < 0) {
+                    enter(next);
+                } else if (onStack.contains(next)) {
+                    low[node] = qMin(low[node], index[next]);
+                }
+                continue;
+            }
+
+            stack.removeLast();
+            if (!stack.isEmpty()) {
+                quint32 parent = stack.last().first;
+                low[parent] = qMin(low[parent], low[node]);
+            }
+            if (low[node] != index[node]) {
+                continue;
+            }
+
+            // node roots a component; every unit it depends on has already
+            // been emitted, so levels are known
+            int unit = units.size();
+            QVector<quint32> component;
+            quint32 member;
+            do {
+                member = members.takeLast();
+                onStack.remove(member);
+                componentOf[member] = unit;
+                component.append(member);
+            } while (member != node);
+
+            int level = 0;
+            for (quint32 m : component) {
+                for (const quint32 *dep = dependenciesBegin(m); dep != dependenciesEnd(m); ++dep) {
+                    int other = componentOf[*dep];
+                    if (other != unit) {
+                        level = qMax(level, unitLevels[other] + 1);
+                    }
+                }
+            }
+
+            units.append(component);
+            unitLevels.append(level);
+        }
+    }
+}
+
+quint32 DependencyGraph::intern(const QString &name) {
+    auto it = ids.constFind(name);
+    if (it != ids.constEnd()) {
+        return it.value();
+    }
+
+    quint32 id = static_cast<quint32>(names.size());
+    ids.insert(name, id);
+    names.append(name);
+    return id;
+}
@@ -0,0 +1,90 @@
+#ifndef DEPENDENCYGRAPH_H
+#define DEPENDENCYGRAPH_H
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QHash>
+#include <QVector>
+
+// Fixed-size set of node ids backed by a bit array
+class NodeSet {
+public:
+    explicit NodeSet(int size = 0)
+        : words((size + 63) / 64, 0)
+    {
+    }
+
+    bool contains(quint32 id) const {
+        return (words[id >> 6] >> (id & 63)) & 1;
+    }
+
+    void insert(quint32 id) {
+        words[id >> 6] |= quint64(1) << (id & 63);
+    }
+
+    void remove(quint32 id) {
+        words[id >> 6] &= ~(quint64(1) << (id & 63));
+    }
+
+private:
+    QVector<quint64> words;
+};
+
+// A dependency map compiled into integer form: every package name is
+// interned once to a dense id, and the edges "a depends on b" are stored
+// as compressed sparse rows (offsets + edges). All traversals are
+// iterative and keep their visited state in bitsets.
+class DependencyGraph {
+public:
+    static constexpr quint32 InvalidId = 0xffffffffu;
+
+    // Build from a name map; extra names become nodes even without an entry
+    explicit DependencyGraph(const QMap<QString, QStringList> &dependencies,
+                             const QStringList &extraNames = QStringList());
+
+    int nodeCount() const;
+    int edgeCount() const;
+
+    // Map between names and ids
+    quint32 find(const QString &name) const;
+    const QString &name(quint32 id) const;
+    QVector<quint32> idsOf(const QStringList &names) const;
+    QStringList namesOf(const QVector<quint32> &ids) const;
+
+    // Direct dependencies of a node as [begin, end)
+    const quint32 *dependenciesBegin(quint32 id) const;
+    const quint32 *dependenciesEnd(quint32 id) const;
+
+    // Check whether any cycle exists in the whole graph
+    bool hasCycle() const;
+
+    // Roots and everything they depend on, each once, in discovery order
+    QVector<quint32> closure(const QVector<quint32> &roots) const;
+
+    // One DFS over the closure of roots that yields it in install order
+    // (dependencies before dependents); on a cycle returns false and fills
+    // cycle with its path, first node repeated at the end
+    bool resolve(const QVector<quint32> &roots, QVector<quint32> &order,
+                 QVector<quint32> &cycle) const;
+
+    // Shortest distance from any root, -1 when unreachable
+    QVector<int> depths(const QVector<quint32> &roots) const;
+
+    // Strongly connected components of the closure of roots (Tarjan), in
+    // install order. Each component is a cycle, or a single package, that
+    // must be installed as one unit. unitLevels gets each unit's level in
+    // the condensed DAG: a unit depends only on units at lower levels.
+    void condense(const QVector<quint32> &roots, QVector<QVector<quint32>> &units,
+                  QVector<int> &unitLevels) const;
+
+private:
+    quint32 intern(const QString &name);
+
+    QHash<QString, quint32> ids;
+    QVector<QString> names;
+    QVector<quint32> offsets;
+    QVector<quint32> edges;
+};
+
+#endif // DEPENDENCYGRAPH_H
@@ -1,6 +1,7 @@
 #include "dependencyscreen.h"
-#include "packageparser.h"
+#include "packagesession.h"
 #include "dependencyanalyzer.h"
+#include "installedpackageindex.h"
 #include "logger.h"
 
 #include <QVBoxLayout>
@@ -10,12 +11,58 @@
 #include <QTreeWidget>
 #include <QTreeWidgetItem>
 #include <QFont>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
 
-DependencyScreen::DependencyScreen(std::shared_ptr<Logger> logger, QWidget *parent)
+// Result of one analysis, computed off the GUI thread
+struct DependencyReport {
+    QMap<QString, DependencyNode> tree;
+    InstallPlan plan;
+    QStringList unsatisfied;
+};
+
+namespace {
+
+DependencyReport analyze(std::shared_ptr<Logger> logger, const PackageTable &packages,
+                         const QMap<QString, QStringList> &dependencies,
+                         const QMap<QString, QStringList> &provides) {
+    DependencyAnalyzer analyzer(logger);
+
+    // Get package names
+    QStringList packageNames;
+    for (const PackageInfo &pkg : packages) {
+        packageNames.append(pkg.name);
+    }
+
+    // Resolve versioned relations, then build dependency tree
+    ResolvedDependencies resolved = analyzer.resolveConstraints(packages, dependencies, provides);
+
+    DependencyReport report;
+    report.tree = analyzer.buildDependencyTree(packageNames, resolved.edges, resolved.versions);
+    report.plan = analyzer.planInstallation(packageNames, resolved);
+    report.unsatisfied = resolved.unsatisfied;
+    return report;
+}
+
+} // namespace
+
+DependencyScreen::DependencyScreen(std::shared_ptr<Logger> logger,
+                                   std::shared_ptr<PackageSession> session,
+                                   QWidget *parent)
     : QWidget(parent)
     , logger(logger)
+    , session(session)
+    , analysisGeneration(0)
 {
     initializeUI();
+
+    // Keep install states current while packages are installed
+    connect(InstalledPackageIndex::instance(logger).get(), &InstalledPackageIndex::changed,
+            this, [this]() {
+                if (isVisible() && !currentPackagePath.isEmpty()) {
+                    displayDependencyTree();
+                }
+            });
 }
 
 void DependencyScreen::analyzeDependencies(const QString &packagePath) {
@@ -80,38 +127,56 @@ void DependencyScreen::initializeUI() {
 }
 
 void DependencyScreen::displayDependencyTree() {
-    dependencyTree->clear();
-
-    PackageParser parser(logger);
-    if (!parser.parsePackage(currentPackagePath)) {
-        statusLabel->setText(QString("错误: %1").arg(parser.getErrorMessage()));
+    if (!session->open(currentPackagePath)) {
+        ++analysisGeneration;
+        dependencyTree->clear();
+        installButton->setEnabled(false);
+        statusLabel->setText(QString("错误: %1").arg(session->getErrorMessage()));
         return;
     }
 
-    PackageMetadata metadata = parser.getMetadata();
-    QMap<QString, QStringList> dependencies = parser.getDependencies();
-
-    DependencyAnalyzer analyzer(logger);
-
-    // Get package names
-    QStringList packageNames;
-    for (const PackageInfo &pkg : metadata.packages) {
-        packageNames.append(pkg.name);
-    }
+    // The installed-package index may query rpm on first use, which must
+    // not spin an event loop on the GUI thread; the tree is filled in from
+    // the result
+    int generation = ++analysisGeneration;
+    statusLabel->setText("分析依赖关系中...");
+    statusLabel->setToolTip(QString());
+    installButton->setEnabled(false);
+
+    std::shared_ptr<Logger> logger = this->logger;
+    PackageTable packages = session->getMetadata().packages;
+    QMap<QString, QStringList> dependencies = session->getDependencies();
+    QMap<QString, QStringList> provides = session->getProvides();
+
+    auto *watcher = new QFutureWatcher<DependencyReport>(this);
+    connect(watcher, &QFutureWatcher<DependencyReport>::finished, this, [this, watcher, generation]() {
+        watcher->deleteLater();
+        if (generation == analysisGeneration) {
+            showReport(watcher->result());
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([logger, packages, dependencies, provides]() {
+        return analyze(logger, packages, dependencies, provides);
+    }));
+}
 
-    // Build dependency tree
-    auto depTree = analyzer.buildDependencyTree(packageNames, dependencies);
+void DependencyScreen::showReport(const DependencyReport &report) {
+    dependencyTree->clear();
 
     // Display tree
     int installedCount = 0;
     int totalCount = 0;
 
-    for (const auto &node : depTree) {
+    for (const auto &node : report.tree) {
         totalCount++;
         QTreeWidgetItem *item = new QTreeWidgetItem();
         item->setText(0, node.name);
-        item->setText(1, node.installed ? "已安装" : "待安装");
-        item->setText(2, "");
+        if (report.plan.upgrade.contains(node.name)) {
+            item->setText(1, "待升级");
+        } else {
+            item->setText(1, node.installed ? "已安装" : "待安装");
+        }
+        item->setText(2, node.version);
 
         if (node.installed) {
             installedCount++;
@@ -121,8 +186,15 @@ void DependencyScreen::displayDependencyTree() {
         dependencyTree->addTopLevelItem(item);
     }
 
-    statusLabel->setText(QString("依赖分析完成: 共 %1 个包，其中 %2 个已安装")
-                         .arg(totalCount).arg(installedCount));
+    statusLabel->setText(QString("依赖分析完成: 共 %1 个包，其中 %2 个已安装，需要安装 %3 个")
+                         .arg(totalCount).arg(installedCount).arg(report.plan.install.size()));
+    statusLabel->setToolTip(QString());
+    if (!report.unsatisfied.isEmpty()) {
+        statusLabel->setText(statusLabel->text()
+                             + QString("，%1 条依赖版本无法满足").arg(report.unsatisfied.size()));
+        statusLabel->setToolTip(report.unsatisfied.join("\n"));
+    }
+    installButton->setEnabled(true);
 
     logger->info(QString("依赖分析完成: 总计 %1 个包，已安装 %2 个").arg(totalCount).arg(installedCount));
 }
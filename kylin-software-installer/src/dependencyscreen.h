@@ -8,12 +8,16 @@ class QTreeWidget;
 class QLabel;
 class QPushButton;
 class Logger;
+class PackageSession;
+struct DependencyReport;
 
 class DependencyScreen : public QWidget {
     Q_OBJECT
 
 public:
-    explicit DependencyScreen(std::shared_ptr<Logger> logger, QWidget *parent = nullptr);
+    explicit DependencyScreen(std::shared_ptr<Logger> logger,
+                              std::shared_ptr<PackageSession> session,
+                              QWidget *parent = nullptr);
 
     void analyzeDependencies(const QString &packagePath);
 
@@ -28,9 +32,12 @@ private slots:
 private:
     void initializeUI();
     void displayDependencyTree();
+    void showReport(const DependencyReport &report);
 
     std::shared_ptr<Logger> logger;
+    std::shared_ptr<PackageSession> session;
     QString currentPackagePath;
+    int analysisGeneration;     // only the latest analysis is shown
 
     QLabel *statusLabel;
     QTreeWidget *dependencyTree;
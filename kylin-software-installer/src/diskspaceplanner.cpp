@@ -0,0 +1,128 @@
+#include "diskspaceplanner.h"
+#include "logger.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStandardPaths>
+#include <sys/statvfs.h>
+
+namespace {
+
+// Left free beyond the package files for the package manager's own
+// temporary files; installed contents are not estimated
+const qint64 kHeadroomBytes = 64 * 1024 * 1024;
+
+double megabytes(qint64 bytes) {
+    return bytes / (1024.0 * 1024);
+}
+
+} // namespace
+
+DiskSpacePlanner::DiskSpacePlanner(std::shared_ptr<Logger> logger)
+    : logger(logger)
+{
+}
+
+bool DiskSpacePlanner::plan(qint64 totalBytes, qint64 largestWaveBytes, DiskPlan &result) {
+    errorMessage.clear();
+    result = DiskPlan();
+
+    QString roomiest;
+    qint64 mostAvailable = -1;
+    for (const QString &candidate : candidates()) {
+        // A candidate that does not exist yet is judged by the directory
+        // it would be created in
+        QString probe = existingAncestor(candidate);
+        QFileInfo info(probe);
+        qint64 available = availableBytes(probe);
+        if (probe.isEmpty() || !info.isWritable() || available < 0) {
+            continue;
+        }
+        logger->info(QString("临时目录候选 %1: 可用 %2 MB").arg(candidate).arg(megabytes(available), 0, 'f', 1));
+
+        if (available >= totalBytes + kHeadroomBytes && QDir().mkpath(candidate)) {
+            result.directory = candidate;
+            result.available = available;
+            result.required = totalBytes;
+            logger->info(QString("解压到 %1，需要 %2 MB").arg(candidate).arg(megabytes(totalBytes), 0, 'f', 1));
+            return true;
+        }
+        if (available > mostAvailable) {
+            roomiest = candidate;
+            mostAvailable = available;
+        }
+    }
+
+    if (roomiest.isEmpty() || !QDir().mkpath(roomiest)) {
+        errorMessage = "没有可用的临时目录";
+        logger->error(errorMessage);
+        return false;
+    }
+
+    // Only package files are counted: what the package manager unpacks
+    // lands on the target file systems and is not estimated
+    if (mostAvailable < largestWaveBytes + kHeadroomBytes) {
+        errorMessage = QString("磁盘空间不足: 最大的一层软件包文件需要 %1 MB，%2 仅剩 %3 MB"
+                               "（未计入软件包安装后占用的空间）")
+            .arg(megabytes(largestWaveBytes + kHeadroomBytes), 0, 'f', 1)
+            .arg(roomiest)
+            .arg(megabytes(mostAvailable), 0, 'f', 1);
+        logger->error(errorMessage);
+        return false;
+    }
+
+    result.directory = roomiest;
+    result.available = mostAvailable;
+    result.required = largestWaveBytes;
+    result.lowSpace = true;
+    logger->warning(QString("磁盘空间不足以容纳全部 %1 MB，改为逐层解压到 %2，软件包文件峰值 %3 MB；"
+                            "软件包安装后占用的空间未计入，目标文件系统仍需足够空间")
+                    .arg(megabytes(totalBytes), 0, 'f', 1)
+                    .arg(roomiest)
+                    .arg(megabytes(largestWaveBytes), 0, 'f', 1));
+    return true;
+}
+
+QStringList DiskSpacePlanner::candidates() const {
+    QStringList result;
+    QSettings settings("Kylin", "SoftwareInstaller");
+    QString configured = settings.value("install/workDir").toString();
+    if (!configured.isEmpty()) {
+        result.append(QDir::cleanPath(configured));
+    }
+
+    QString appWork = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/work";
+    for (const QString &path : {QDir::tempPath(), QString("/var/tmp"), appWork}) {
+        QString clean = QDir::cleanPath(path);
+        if (!result.contains(clean)) {
+            result.append(clean);
+        }
+    }
+    return result;
+}
+
+QString DiskSpacePlanner::existingAncestor(const QString &path) {
+    QString current = QDir::cleanPath(path);
+    while (!QFileInfo(current).isDir()) {
+        QString parent = QFileInfo(current).path();
+        if (parent == current) {
+            return QString();
+        }
+        current = parent;
+    }
+    return current;
+}
+
+qint64 DiskSpacePlanner::availableBytes(const QString &path) {
+    struct statvfs stats;
+    if (statvfs(QFile::encodeName(path).constData(), &stats) != 0) {
+        return -1;
+    }
+    return static_cast<qint64>(stats.f_bavail) * static_cast<qint64>(stats.f_frsize);
+}
+
+QString DiskSpacePlanner::getErrorMessage() const {
+    return errorMessage;
+}
@@ -0,0 +1,57 @@
+#ifndef DISKSPACEPLANNER_H
+#define DISKSPACEPLANNER_H
+
+#include <QString>
+#include <QStringList>
+#include <memory>
+
+class Logger;
+
+// Where and how the package files of an install are extracted
+struct DiskPlan {
+    QString directory;      // parent of the work directory
+    qint64 available = 0;   // free bytes there when planned
+    qint64 required = 0;    // peak bytes the install puts there
+    bool lowSpace = false;  // extract one wave at a time, delete after install
+};
+
+// Chooses a work directory for extracted package files by free space.
+// Candidates, in order of preference:
+//
+//   install/workDir    configured directory, if any
+//   QDir::tempPath()   usually /tmp, a small tmpfs on thin clients
+//   /var/tmp
+//   AppData/work
+//
+// The first candidate that holds the whole plan wins. Otherwise the one
+// with the most room is used in low-space mode if it holds the largest
+// install wave, since only one wave is then on disk at a time. Only the
+// package files are counted: the space their contents take once the
+// package manager unpacks them onto the target file systems is not
+// estimated, since metadata.json carries no installed sizes.
+class DiskSpacePlanner {
+public:
+    explicit DiskSpacePlanner(std::shared_ptr<Logger> logger);
+
+    // Plan for totalBytes of package files, largestWaveBytes of them in
+    // the largest wave; false if no candidate has room even for that
+    bool plan(qint64 totalBytes, qint64 largestWaveBytes, DiskPlan &result);
+
+    // Candidate directories, in order of preference; they are created
+    // only once plan() picks one
+    QStringList candidates() const;
+
+    // Get free bytes for unprivileged users on the filesystem of path, or -1
+    static qint64 availableBytes(const QString &path);
+
+    // Get error message
+    QString getErrorMessage() const;
+
+private:
+    static QString existingAncestor(const QString &path);
+
+    std::shared_ptr<Logger> logger;
+    QString errorMessage;
+};
+
+#endif // DISKSPACEPLANNER_H
@@ -0,0 +1,237 @@
+#include "extractioncache.h"
+#include "logger.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <algorithm>
+
+namespace {
+
+const qint64 kDefaultMaxSizeMB = 20480;
+const qint64 kStaleStagingSecs = 24 * 60 * 60;
+
+} // namespace
+
+ExtractionCache::ExtractionCache(std::shared_ptr<Logger> logger)
+    : logger(logger)
+    , available(false)
+{
+    rootDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/cache";
+    available = QDir().mkpath(rootDir + "/entries") && QDir().mkpath(rootDir + "/staging");
+
+    QSettings settings("Kylin", "SoftwareInstaller");
+    maxSize = settings.value("cache/maxSizeMB", kDefaultMaxSizeMB).toLongLong() * 1024 * 1024;
+
+    if (available) {
+        removeStaleStaging();
+    } else {
+        logger->warning(QString("无法创建解压缓存目录: %1").arg(rootDir));
+    }
+}
+
+bool ExtractionCache::isAvailable() const {
+    return available;
+}
+
+QString ExtractionCache::keyFor(const QString &bundlePath) {
+    QFileInfo fileInfo(bundlePath);
+    QString stamp = QString("%1-%2").arg(fileInfo.size()).arg(fileInfo.lastModified().toMSecsSinceEpoch());
+
+    // Remember the hash per path so an unchanged bundle is never re-read
+    QSettings fingerprints(rootDir + "/fingerprints.ini", QSettings::IniFormat);
+    QString pathKey = QString::fromLatin1(
+        QCryptographicHash::hash(fileInfo.absoluteFilePath().toUtf8(), QCryptographicHash::Md5).toHex());
+    QString known = fingerprints.value(pathKey).toString();
+    if (known.endsWith("-" + stamp)) {
+        return known;
+    }
+
+    QFile file(bundlePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+
+    logger->info(QString("计算软件包指纹: %1").arg(bundlePath));
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!hash.addData(&file)) {
+        return QString();
+    }
+
+    QString key = QString::fromLatin1(hash.result().toHex()) + "-" + stamp;
+    fingerprints.setValue(pathKey, key);
+    return key;
+}
+
+QString ExtractionCache::payloadDir(const QString &key) {
+    if (!available || key.isEmpty()) {
+        return QString();
+    }
+
+    QString dir = entryDir(key) + "/payload";
+    if (!QFileInfo(dir).isDir()) {
+        return QString();
+    }
+
+    touch(key);
+    return dir;
+}
+
+QString ExtractionCache::beginPayload(const QString &key) {
+    if (!available || key.isEmpty()) {
+        return QString();
+    }
+
+    QTemporaryDir staging(rootDir + "/staging/" + key + "-XXXXXX");
+    if (!staging.isValid()) {
+        return QString();
+    }
+    staging.setAutoRemove(false);
+    return staging.path();
+}
+
+bool ExtractionCache::publishPayload(const QString &key, const QString &stagingDir) {
+    QString target = entryDir(key) + "/payload";
+    if (!QDir().mkpath(entryDir(key))) {
+        discardPayload(stagingDir);
+        return false;
+    }
+
+    // Another instance may have published the same bundle meanwhile
+    if (QFileInfo(target).isDir()) {
+        discardPayload(stagingDir);
+        touch(key);
+        return true;
+    }
+
+    qint64 size = directorySize(stagingDir);
+    if (!QDir().rename(stagingDir, target)) {
+        logger->warning(QString("发布解压缓存失败: %1").arg(key));
+        discardPayload(stagingDir);
+        return false;
+    }
+
+    touch(key, size);
+    logger->info(QString("解压结果已缓存: %1 (%2 MB)").arg(key).arg(size / (1024 * 1024)));
+    evict(key);
+    return true;
+}
+
+void ExtractionCache::discardPayload(const QString &stagingDir) {
+    if (!stagingDir.isEmpty()) {
+        QDir(stagingDir).removeRecursively();
+    }
+}
+
+void ExtractionCache::setMaxSize(qint64 bytes) {
+    maxSize = bytes;
+}
+
+QString ExtractionCache::entryDir(const QString &key) const {
+    return rootDir + "/entries/" + key;
+}
+
+void ExtractionCache::touch(const QString &key, qint64 payloadSize) {
+    QString infoPath = entryDir(key) + "/entry.json";
+
+    QJsonObject info;
+    QFile existing(infoPath);
+    if (existing.open(QIODevice::ReadOnly)) {
+        info = QJsonDocument::fromJson(existing.readAll()).object();
+        existing.close();
+    }
+
+    info["lastUsed"] = QDateTime::currentMSecsSinceEpoch();
+    if (payloadSize >= 0) {
+        info["payloadSize"] = payloadSize;
+    }
+
+    QSaveFile file(infoPath);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(info).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+}
+
+void ExtractionCache::evict(const QString &keepKey) {
+    struct Entry {
+        QString key;
+        qint64 lastUsed;
+        qint64 size;
+    };
+
+    QList<Entry> entries;
+    qint64 totalSize = 0;
+    QDir dir(rootDir + "/entries");
+    for (const QString &key : dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFile file(entryDir(key) + "/entry.json");
+        QJsonObject info;
+        if (file.open(QIODevice::ReadOnly)) {
+            info = QJsonDocument::fromJson(file.readAll()).object();
+        }
+
+        Entry entry;
+        entry.key = key;
+        entry.lastUsed = static_cast<qint64>(info.value("lastUsed").toDouble());
+        entry.size = static_cast<qint64>(info.value("payloadSize").toDouble());
+        totalSize += entry.size;
+        entries.append(entry);
+    }
+
+    if (totalSize <= maxSize) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.lastUsed < b.lastUsed;
+    });
+
+    for (const Entry &entry : entries) {
+        if (totalSize <= maxSize) {
+            break;
+        }
+        if (entry.key == keepKey) {
+            continue;
+        }
+
+        // Move out of entries/ first so a half-deleted entry is never visible
+        QString trash = rootDir + "/staging/" + entry.key + "-evicted";
+        if (QDir().rename(entryDir(entry.key), trash)) {
+            QDir(trash).removeRecursively();
+        } else {
+            QDir(entryDir(entry.key)).removeRecursively();
+        }
+        totalSize -= entry.size;
+        logger->info(QString("淘汰解压缓存: %1").arg(entry.key));
+    }
+}
+
+void ExtractionCache::removeStaleStaging() {
+    // Staging directories left behind by a crash are never published
+    QDir staging(rootDir + "/staging");
+    QDateTime cutoff = QDateTime::currentDateTime().addSecs(-kStaleStagingSecs);
+    for (const QFileInfo &info : staging.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (info.lastModified() < cutoff || info.fileName().endsWith("-evicted")) {
+            QDir(info.absoluteFilePath()).removeRecursively();
+        }
+    }
+}
+
+qint64 ExtractionCache::directorySize(const QString &path) {
+    qint64 size = 0;
+    QDirIterator it(path, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        size += it.fileInfo().size();
+    }
+    return size;
+}
@@ -0,0 +1,60 @@
+#ifndef EXTRACTIONCACHE_H
+#define EXTRACTIONCACHE_H
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <memory>
+
+class Logger;
+
+// Persistent cache of extracted payloads under the AppData location.
+// Entries are keyed by "<sha256>-<size>-<mtime>" of the bundle, published
+// atomically by rename and evicted least-recently-used once the total
+// size exceeds the configured limit. Parsed manifests are cached
+// separately, see ManifestSidecar.
+//
+// Layout:
+//   cache/entries/<key>/entry.json     last use time and payload size
+//   cache/entries/<key>/payload/       extracted bundle tree
+//   cache/staging/<key>-XXXXXX/        payload being extracted
+class ExtractionCache {
+public:
+    explicit ExtractionCache(std::shared_ptr<Logger> logger);
+
+    // Whether the cache directory is usable
+    bool isAvailable() const;
+
+    // Compute the cache key of a bundle; the hash is only recomputed when
+    // the file's size or mtime changed since it was last seen
+    QString keyFor(const QString &bundlePath);
+
+    // Get the extracted payload of an entry, or an empty string
+    QString payloadDir(const QString &key);
+
+    // Create a private staging directory to extract a payload into
+    QString beginPayload(const QString &key);
+
+    // Atomically publish a staged payload, then evict to the size limit
+    bool publishPayload(const QString &key, const QString &stagingDir);
+
+    // Remove a staging directory after a failed extraction
+    void discardPayload(const QString &stagingDir);
+
+    // Set size limit in bytes
+    void setMaxSize(qint64 bytes);
+
+private:
+    QString entryDir(const QString &key) const;
+    void touch(const QString &key, qint64 payloadSize = -1);
+    void evict(const QString &keepKey);
+    void removeStaleStaging();
+    static qint64 directorySize(const QString &path);
+
+    std::shared_ptr<Logger> logger;
+    QString rootDir;
+    qint64 maxSize;
+    bool available;
+};
+
+#endif // EXTRACTIONCACHE_H
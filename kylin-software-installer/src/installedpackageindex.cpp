@@ -0,0 +1,470 @@
+#include "installedpackageindex.h"
+#include "logger.h"
+#include "processrunner.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QThread>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <cstring>
+
+namespace {
+
+const char kDpkgDir[] = "/var/lib/dpkg";
+const char kDpkgStatusPath[] = "/var/lib/dpkg/status";
+const char kDpkgUpdatesDir[] = "/var/lib/dpkg/updates";
+const char *const kRpmDatabaseDirs[] = { "/var/lib/rpm", "/usr/lib/sysimage/rpm" };
+const int kDebounceMs = 200;
+const int kRpmQueryTimeoutMs = 60 * 1000;
+
+QString recordKey(const QString &name, const QString &architecture) {
+    return name + ":" + architecture;
+}
+
+// Parse the fields we index from one stanza; with identityOnly set only
+// Package and Architecture are read
+void parseStanza(const char *pos, const char *end, InstalledPackage &pkg, bool identityOnly) {
+    pkg = InstalledPackage();
+    pkg.installed = false;
+
+    while (pos < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(pos, '\n', end - pos));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+
+        // Continuation lines start with whitespace
+        if (*pos != ' ' && *pos != '\t') {
+            const char *colon = static_cast<const char *>(memchr(pos, ':', lineEnd - pos));
+            if (colon) {
+                QByteArray key = QByteArray::fromRawData(pos, static_cast<int>(colon - pos));
+                const char *value = colon + 1;
+                while (value < lineEnd && *value == ' ') {
+                    ++value;
+                }
+                int valueLength = static_cast<int>(lineEnd - value);
+
+                if (key == "Package") {
+                    pkg.name = QString::fromUtf8(value, valueLength);
+                } else if (key == "Architecture") {
+                    pkg.architecture = QString::fromUtf8(value, valueLength);
+                } else if (identityOnly) {
+                    // Skip
+                } else if (key == "Version") {
+                    pkg.version = QString::fromUtf8(value, valueLength);
+                } else if (key == "Status") {
+                    pkg.status = QString::fromUtf8(value, valueLength);
+                    pkg.installed = pkg.status.endsWith(" installed");
+                }
+            }
+        }
+
+        pos = lineEnd + 1;
+    }
+}
+
+// Call fn(begin, end) for every blank-line separated stanza
+template <typename Function>
+void forEachStanza(const QByteArray &data, Function fn) {
+    const char *pos = data.constData();
+    const char *end = pos + data.size();
+    const char *stanza = nullptr;
+
+    while (pos < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(pos, '\n', end - pos));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+
+        if (lineEnd == pos) {
+            if (stanza) {
+                fn(stanza, pos);
+                stanza = nullptr;
+            }
+        } else if (!stanza) {
+            stanza = pos;
+        }
+
+        pos = lineEnd + 1;
+    }
+
+    if (stanza) {
+        fn(stanza, end);
+    }
+}
+
+} // namespace
+
+InstalledPackageIndex::InstalledPackageIndex(std::shared_ptr<Logger> logger)
+    : QObject(nullptr)
+    , logger(logger)
+    , watcher(new QFileSystemWatcher(this))
+    , debounceTimer(new QTimer(this))
+    , loaded(false)
+    , useDpkg(QFile::exists(kDpkgStatusPath))
+    , statusStamp{-1, QDateTime()}
+{
+    for (const char *dir : kRpmDatabaseDirs) {
+        if (rpmDatabaseDir.isEmpty() && QFileInfo(dir).isDir()) {
+            rpmDatabaseDir = dir;
+        }
+    }
+
+    // Coalesce the burst of events a single dpkg run produces
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(kDebounceMs);
+    connect(debounceTimer, &QTimer::timeout, this, &InstalledPackageIndex::onDatabaseChanged);
+    connect(watcher, &QFileSystemWatcher::fileChanged,
+            debounceTimer, QOverload<>::of(&QTimer::start));
+    connect(watcher, &QFileSystemWatcher::directoryChanged,
+            debounceTimer, QOverload<>::of(&QTimer::start));
+
+    startWatching();
+}
+
+std::shared_ptr<InstalledPackageIndex> InstalledPackageIndex::instance(std::shared_ptr<Logger> logger) {
+    static QMutex mutex;
+    static std::shared_ptr<InstalledPackageIndex> shared;
+
+    QMutexLocker locker(&mutex);
+    if (!shared) {
+        shared = std::make_shared<InstalledPackageIndex>(logger);
+
+        // Watcher events must be delivered by a thread with an event loop
+        QCoreApplication *app = QCoreApplication::instance();
+        if (app && QThread::currentThread() != app->thread()) {
+            shared->moveToThread(app->thread());
+        }
+    }
+    return shared;
+}
+
+bool InstalledPackageIndex::isInstalled(const QString &name) {
+    ensureLoaded();
+    QReadLocker locker(&lock);
+    auto it = packages.constFind(name);
+    return it != packages.constEnd() && it->installed;
+}
+
+QString InstalledPackageIndex::installedVersion(const QString &name) {
+    ensureLoaded();
+    QReadLocker locker(&lock);
+    auto it = packages.constFind(name);
+    return (it != packages.constEnd() && it->installed) ? it->version : QString();
+}
+
+bool InstalledPackageIndex::lookup(const QString &name, InstalledPackage &package) {
+    ensureLoaded();
+    QReadLocker locker(&lock);
+    auto it = packages.constFind(name);
+    if (it == packages.constEnd()) {
+        return false;
+    }
+    package = *it;
+    return true;
+}
+
+int InstalledPackageIndex::size() {
+    ensureLoaded();
+    QReadLocker locker(&lock);
+    return packages.size();
+}
+
+bool InstalledPackageIndex::reload() {
+    QMutexLocker guard(&refreshMutex);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ok;
+    if (useDpkg) {
+        ok = refreshDpkg(true);
+    } else {
+        QHash<QString, InstalledPackage> result;
+        ok = loadRpmDatabase(result);
+        QWriteLocker locker(&lock);
+        packages.swap(result);
+    }
+
+    QWriteLocker locker(&lock);
+    loaded = true;
+
+    logger->info(QString("已加载系统软件包索引: %1 个软件包，耗时 %2 ms")
+                 .arg(packages.size()).arg(timer.elapsed()));
+    return ok;
+}
+
+bool InstalledPackageIndex::refresh() {
+    {
+        QReadLocker locker(&lock);
+        if (!loaded) {
+            locker.unlock();
+            return reload();
+        }
+    }
+
+    QMutexLocker guard(&refreshMutex);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool changed = false;
+    if (useDpkg) {
+        changed = refreshDpkg(false);
+    } else if (!rpmDatabaseDir.isEmpty()) {
+        // rpmdb is opaque; a single full query is the finest granularity
+        FileStamp stamp = stampOf(rpmDatabaseDir);
+        if (stamp.size != statusStamp.size || stamp.modified != statusStamp.modified) {
+            QHash<QString, InstalledPackage> result;
+            if (loadRpmDatabase(result)) {
+                QWriteLocker locker(&lock);
+                packages.swap(result);
+                changed = true;
+            }
+            statusStamp = stamp;
+        }
+    }
+
+    if (changed) {
+        logger->debug(QString("系统软件包索引已增量更新，耗时 %1 ms").arg(timer.elapsed()));
+    }
+    return changed;
+}
+
+void InstalledPackageIndex::onDatabaseChanged() {
+    // dpkg replaces status by rename, which drops the file watch
+    if (useDpkg && !watcher->files().contains(kDpkgStatusPath) && QFile::exists(kDpkgStatusPath)) {
+        watcher->addPath(kDpkgStatusPath);
+    }
+
+    // A refresh is already running, possibly further up this thread's
+    // stack while the rpm query spins its event loop; look again later
+    if (!refreshMutex.tryLock()) {
+        debounceTimer->start();
+        return;
+    }
+    refreshMutex.unlock();
+
+    // The rpm query spins an event loop, so it must not run on the GUI
+    // thread; changed() is then delivered queued
+    if (!useDpkg) {
+        QtConcurrent::run([this]() {
+            if (refresh()) {
+                emit changed();
+            }
+        });
+        return;
+    }
+
+    if (refresh()) {
+        emit changed();
+    }
+}
+
+void InstalledPackageIndex::ensureLoaded() {
+    {
+        QReadLocker locker(&lock);
+        if (loaded) {
+            return;
+        }
+    }
+    reload();
+}
+
+void InstalledPackageIndex::startWatching() {
+    QStringList paths;
+    if (useDpkg) {
+        paths << kDpkgDir << kDpkgStatusPath;
+        if (QFileInfo(kDpkgUpdatesDir).isDir()) {
+            paths << kDpkgUpdatesDir;
+        }
+    } else if (!rpmDatabaseDir.isEmpty()) {
+        paths << rpmDatabaseDir;
+    }
+
+    if (!paths.isEmpty()) {
+        watcher->addPaths(paths);
+    }
+}
+
+bool InstalledPackageIndex::refreshDpkg(bool full) {
+    QSet<QString> affected;
+
+    if (full) {
+        records.clear();
+        stanzaHashes.clear();
+        architectures.clear();
+        appliedUpdates.clear();
+        statusStamp = FileStamp{-1, QDateTime()};
+
+        QWriteLocker locker(&lock);
+        packages.clear();
+    }
+
+    FileStamp stamp = stampOf(kDpkgStatusPath);
+    if (stamp.size != statusStamp.size || stamp.modified != statusStamp.modified) {
+        QFile file(kDpkgStatusPath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            logger->warning(QString("无法读取 dpkg 状态文件: %1").arg(kDpkgStatusPath));
+            return false;
+        }
+
+        applyDpkgStanzas(file.readAll(), true, affected);
+        statusStamp = stamp;
+
+        // A rewritten status file has absorbed the journal; re-apply what is left
+        appliedUpdates.clear();
+    }
+
+    // Entries dpkg has recorded but not yet merged into status, in order
+    QDir updatesDir(kDpkgUpdatesDir);
+    for (const QString &name : updatesDir.entryList(QDir::Files, QDir::Name)) {
+        bool numeric = false;
+        name.toInt(&numeric);
+        if (!numeric) {
+            continue;
+        }
+
+        QString path = updatesDir.filePath(name);
+        FileStamp updateStamp = stampOf(path);
+        auto applied = appliedUpdates.constFind(name);
+        if (applied != appliedUpdates.constEnd()
+                && applied->size == updateStamp.size && applied->modified == updateStamp.modified) {
+            continue;
+        }
+
+        QFile file(path);
+        if (file.open(QIODevice::ReadOnly)) {
+            applyDpkgStanzas(file.readAll(), false, affected);
+            appliedUpdates.insert(name, updateStamp);
+        }
+    }
+
+    if (!affected.isEmpty()) {
+        updatePackages(affected);
+    }
+    return !affected.isEmpty();
+}
+
+bool InstalledPackageIndex::applyDpkgStanzas(const QByteArray &data, bool removeMissing, QSet<QString> &affected) {
+    QSet<QString> seen;
+    if (removeMissing) {
+        seen.reserve(records.size());
+    }
+
+    forEachStanza(data, [&](const char *begin, const char *end) {
+        InstalledPackage pkg;
+        parseStanza(begin, end, pkg, true);
+        if (pkg.name.isEmpty()) {
+            return;
+        }
+
+        QString key = recordKey(pkg.name, pkg.architecture);
+        if (removeMissing) {
+            seen.insert(key);
+        }
+
+        // Unchanged bytes mean an unchanged record; skip the full parse
+        uint hash = qHashBits(begin, static_cast<size_t>(end - begin));
+        auto known = stanzaHashes.constFind(key);
+        if (known != stanzaHashes.constEnd() && *known == hash) {
+            return;
+        }
+
+        parseStanza(begin, end, pkg, false);
+        records.insert(key, pkg);
+        stanzaHashes.insert(key, hash);
+        architectures.insert(pkg.architecture);
+        affected.insert(pkg.name);
+    });
+
+    if (removeMissing) {
+        for (auto it = records.begin(); it != records.end();) {
+            if (seen.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            affected.insert(it->name);
+            stanzaHashes.remove(it.key());
+            it = records.erase(it);
+        }
+    }
+    return true;
+}
+
+void InstalledPackageIndex::updatePackages(const QSet<QString> &names) {
+    QWriteLocker locker(&lock);
+    for (const QString &name : names) {
+        // Multi-arch packages share a name; prefer the installed instance
+        const InstalledPackage *best = nullptr;
+        for (const QString &architecture : architectures) {
+            auto it = records.constFind(recordKey(name, architecture));
+            if (it != records.constEnd() && (!best || (!best->installed && it->installed))) {
+                best = &it.value();
+            }
+        }
+
+        if (best) {
+            packages.insert(name, *best);
+        } else {
+            packages.remove(name);
+        }
+    }
+}
+
+bool InstalledPackageIndex::loadRpmDatabase(QHash<QString, InstalledPackage> &result) {
+    // One query for the whole database instead of one `rpm -q` per package
+    ProcessRunner runner(logger);
+    runner.setTimeout(kRpmQueryTimeoutMs);
+    runner.setCaptureOutput(true);
+    ProcessResult query = runner.run("rpm", QStringList() << "-qa" << "--qf"
+                                     << "%{NAME}\\t%|EPOCH?{%{EPOCH}:}:{}|%{VERSION}-%{RELEASE}\\t%{ARCH}\\n");
+    if (!query.succeeded()) {
+        logger->warning("无法查询 rpm 数据库");
+        return false;
+    }
+
+    if (!rpmDatabaseDir.isEmpty()) {
+        statusStamp = stampOf(rpmDatabaseDir);
+    }
+
+    const QList<QByteArray> lines = query.standardOutput.split('\n');
+    result.reserve(lines.size());
+    for (const QByteArray &line : lines) {
+        QList<QByteArray> fields = line.split('\t');
+        if (fields.size() < 3) {
+            continue;
+        }
+
+        InstalledPackage pkg;
+        pkg.name = QString::fromUtf8(fields.at(0));
+        pkg.version = QString::fromUtf8(fields.at(1));
+        pkg.architecture = QString::fromUtf8(fields.at(2));
+        pkg.status = "installed";
+        pkg.installed = true;
+        result.insert(pkg.name, pkg);
+    }
+    return true;
+}
+
+InstalledPackageIndex::FileStamp InstalledPackageIndex::stampOf(const QString &path) {
+    QFileInfo info(path);
+    if (!info.isDir()) {
+        return FileStamp{info.exists() ? info.size() : -1, info.lastModified()};
+    }
+
+    // For a database directory, the newest file stands for the whole
+    FileStamp stamp{0, QDateTime()};
+    for (const QFileInfo &file : QDir(path).entryInfoList(QDir::Files)) {
+        stamp.size += file.size();
+        if (!stamp.modified.isValid() || file.lastModified() > stamp.modified) {
+            stamp.modified = file.lastModified();
+        }
+    }
+    return stamp;
+}
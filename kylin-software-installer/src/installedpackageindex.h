@@ -0,0 +1,100 @@
+#ifndef INSTALLEDPACKAGEINDEX_H
+#define INSTALLEDPACKAGEINDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <memory>
+
+class Logger;
+class QFileSystemWatcher;
+class QTimer;
+
+struct InstalledPackage {
+    QString name;
+    QString version;
+    QString architecture;
+    QString status;     // dpkg "want flag status", e.g. "install ok installed"
+    bool installed;
+};
+
+// The system's installed package set, loaded once from
+// /var/lib/dpkg/status (or a single `rpm -qa`) into a hash map so
+// lookups never spawn a process. Shared by every component.
+//
+// The index stays live: the dpkg database is watched and, on change, only
+// stanzas whose bytes differ from the last pass are re-parsed, with
+// pending entries from dpkg's updates/ journal applied on top.
+class InstalledPackageIndex : public QObject {
+    Q_OBJECT
+
+public:
+    explicit InstalledPackageIndex(std::shared_ptr<Logger> logger);
+
+    // Process-wide index
+    static std::shared_ptr<InstalledPackageIndex> instance(std::shared_ptr<Logger> logger);
+
+    // Check if package is installed
+    bool isInstalled(const QString &name);
+
+    // Get installed version, empty if not installed
+    QString installedVersion(const QString &name);
+
+    // Look up a package record
+    bool lookup(const QString &name, InstalledPackage &package);
+
+    // Number of known packages
+    int size();
+
+    // Discard and load the installed set again
+    bool reload();
+
+    // Bring the index up to date with the database, re-parsing only what
+    // changed; cheap when nothing did
+    bool refresh();
+
+signals:
+    void changed();
+
+private slots:
+    void onDatabaseChanged();
+
+private:
+    struct FileStamp {
+        qint64 size;
+        QDateTime modified;
+    };
+
+    void ensureLoaded();
+    void startWatching();
+    bool refreshDpkg(bool full);
+    bool applyDpkgStanzas(const QByteArray &data, bool removeMissing, QSet<QString> &affected);
+    void updatePackages(const QSet<QString> &names);
+    bool loadRpmDatabase(QHash<QString, InstalledPackage> &result);
+    static FileStamp stampOf(const QString &path);
+
+    std::shared_ptr<Logger> logger;
+    QFileSystemWatcher *watcher;
+    QTimer *debounceTimer;
+
+    // Lookup table, one record per package name
+    QHash<QString, InstalledPackage> packages;
+    QReadWriteLock lock;
+    bool loaded;
+    bool useDpkg;
+    QString rpmDatabaseDir;
+
+    // Incremental state, guarded by refreshMutex
+    QMutex refreshMutex;
+    QHash<QString, InstalledPackage> records;   // keyed by "name:arch"
+    QHash<QString, uint> stanzaHashes;          // keyed by "name:arch"
+    QSet<QString> architectures;
+    FileStamp statusStamp;
+    QHash<QString, FileStamp> appliedUpdates;
+};
+
+#endif // INSTALLEDPACKAGEINDEX_H
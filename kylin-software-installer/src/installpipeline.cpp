@@ -0,0 +1,386 @@
+#include "installpipeline.h"
+#include "logger.h"
+#include "archivereader.h"
+#include "packagemanager.h"
+#include "packageverifier.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QVector>
+#include <set>
+
+namespace {
+
+// Packages buffered between two stages
+const int kQueueDepth = 4;
+
+// Verified package files the install stage takes in ahead of a ready
+// unit; beyond this it leaves them queued so extraction waits
+const int kMaxWaitingItems = 16;
+const qint64 kMaxWaitingBytes = 512 * 1024 * 1024;
+
+} // namespace
+
+InstallPipeline::InstallPipeline(std::shared_ptr<Logger> logger, PackageManager &packageManager,
+                                 QObject *parent)
+    : QObject(parent)
+    , logger(logger)
+    , packageManager(packageManager)
+    , cancelFlag(nullptr)
+    , aborted(false)
+    , progressOffset(0)
+    , progressTotal(0)
+    , extracted(kQueueDepth)
+    , verified(kQueueDepth)
+{
+}
+
+InstallPipeline::~InstallPipeline() = default;
+
+void InstallPipeline::setCancelFlag(const std::atomic<bool> *flag) {
+    cancelFlag = flag;
+}
+
+void InstallPipeline::setWorkDirectory(const QString &parent) {
+    workParent = parent;
+}
+
+void InstallPipeline::setProgressRange(int offset, int total) {
+    progressOffset = offset;
+    progressTotal = total;
+}
+
+bool InstallPipeline::run(const QString &packagePath, const PackageTable &bundle,
+                          const QList<QStringList> &units,
+                          const QMap<QString, QStringList> &dependencies) {
+    QElapsedTimer timer;
+    timer.start();
+
+    workDir = workParent.isEmpty()
+        ? std::make_unique<QTemporaryDir>()
+        : std::make_unique<QTemporaryDir>(workParent + "/kylin-installer-XXXXXX");
+    if (!workDir->isValid()) {
+        abort(QString("无法创建临时目录: %1").arg(workDir->errorString()));
+        return false;
+    }
+
+    QHash<QString, int> rowOf;
+    for (int row = 0; row < bundle.size(); ++row) {
+        rowOf.insert(bundle.name(row), row);
+    }
+
+    // Bundled members of the plan, in installation order
+    QStringList entries;
+    for (const QStringList &unit : units) {
+        for (const QString &package : unit) {
+            auto row = rowOf.constFind(package);
+            if (row == rowOf.constEnd()) {
+                continue;
+            }
+
+            QString filename = bundle.filename(*row);
+            if (filename.isEmpty() || filename.contains('/') || filename == "..") {
+                abort(QString("软件包文件名无效: %1").arg(filename));
+                return false;
+            }
+
+            Item item;
+            item.package = package;
+            item.path = workDir->path() + "/" + filename;
+            item.checksum = PackageVerifier::normalizeChecksum(bundle.checksum(*row));
+            items.insert("packages/" + filename, item);
+            entries.append("packages/" + filename);
+            bundled.insert(package);
+        }
+    }
+    logger->info(QString("流水线安装: %1 个单元，其中 %2 个软件包来自软件包文件")
+                 .arg(units.size()).arg(entries.size()));
+
+    std::unique_ptr<QThread> extractThread(QThread::create([this, packagePath, entries]() {
+        extractStage(packagePath, entries);
+    }));
+    std::unique_ptr<QThread> verifyThread(QThread::create([this]() {
+        verifyStage();
+    }));
+    extractThread->start();
+    verifyThread->start();
+
+    bool ok = installStage(units, dependencies);
+
+    // Unblock and join the other stages whatever the outcome
+    if (!ok) {
+        aborted = true;
+    }
+    extracted.close();
+    verified.close();
+    extractThread->wait();
+    verifyThread->wait();
+    workDir.reset();
+
+    if (ok) {
+        logger->info(QString("流水线安装完成，耗时 %1 ms").arg(timer.elapsed()));
+    }
+    return ok;
+}
+
+QString InstallPipeline::getErrorMessage() const {
+    QMutexLocker locker(&errorMutex);
+    return errorMessage;
+}
+
+void InstallPipeline::extractStage(const QString &packagePath, const QStringList &entries) {
+    ArchiveReader reader(packagePath);
+    QFile file;
+    Item current;
+
+    EntryStreamHandler handler;
+    handler.begin = [&](const ArchiveEntry &entry) {
+        if (isStopped()) {
+            return false;
+        }
+        current = items.value(entry.name);
+        current.entryDigest = entry.digest;
+        file.setFileName(current.path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            abort(QString("无法写入文件: %1").arg(current.path));
+            return false;
+        }
+        return true;
+    };
+    handler.data = [&](const char *data, qint64 size) {
+        if (isStopped()) {
+            return false;
+        }
+        if (file.write(data, size) != size) {
+            abort(QString("写入文件失败: %1").arg(current.path));
+            return false;
+        }
+        return true;
+    };
+    handler.end = [&](const ArchiveEntry &) {
+        bool flushed = file.flush();
+        current.size = file.size();
+        file.close();
+        if (!flushed) {
+            abort(QString("写入文件失败: %1").arg(current.path));
+            return false;
+        }
+        // Blocks while verification is behind
+        return extracted.push(current);
+    };
+
+    if (!reader.streamEntries(entries, handler) && !isStopped()) {
+        abort(QString("解压软件包失败: %1").arg(reader.getErrorMessage()));
+    }
+    extracted.close();
+}
+
+void InstallPipeline::verifyStage() {
+    Item item;
+    while (extracted.pop(item)) {
+        if (isStopped()) {
+            break;
+        }
+
+        if (!item.checksum.isEmpty() || !item.entryDigest.isEmpty()) {
+            QString actual = PackageVerifier::hashFile(item.path, cancelFlag);
+            if (isStopped()) {
+                break;
+            }
+            if (actual.isEmpty()) {
+                abort(QString("无法读取软件包文件: %1").arg(item.path));
+                break;
+            }
+            if (!item.entryDigest.isEmpty() && actual != item.entryDigest) {
+                abort(QString("条目校验和不匹配: %1").arg(item.path));
+                break;
+            }
+            if (!item.checksum.isEmpty() && actual != item.checksum) {
+                abort(QString("校验失败: %1 (期望 %2，实际 %3)").arg(item.path, item.checksum, actual));
+                break;
+            }
+        } else {
+            logger->warning(QString("软件包缺少校验和，未校验: %1").arg(item.package));
+        }
+
+        // Blocks while installation is behind
+        if (!verified.push(item)) {
+            break;
+        }
+    }
+
+    // Extraction may be waiting on a full queue after an early exit
+    extracted.close();
+    verified.close();
+}
+
+bool InstallPipeline::installStage(const QList<QStringList> &units,
+                                   const QMap<QString, QStringList> &dependencies) {
+    const int unitCount = units.size();
+    QHash<QString, int> unitOf;
+    int totalPackages = 0;
+    for (int unit = 0; unit < unitCount; ++unit) {
+        for (const QString &package : units[unit]) {
+            unitOf.insert(package, unit);
+            ++totalPackages;
+        }
+    }
+    int offset = progressOffset;
+    int total = qMax(progressTotal, offset + totalPackages);
+
+    // Per unit: bundled members not yet verified, dependency units not
+    // yet installed, and the units waiting on it
+    QVector<int> unverified(unitCount, 0);
+    QVector<int> blockers(unitCount, 0);
+    QVector<QVector<int>> dependents(unitCount);
+    QHash<QString, QString> targets;    // package -> file, or name for repository packages
+    for (int unit = 0; unit < unitCount; ++unit) {
+        QSet<int> needed;
+        for (const QString &package : units[unit]) {
+            if (bundled.contains(package)) {
+                ++unverified[unit];
+            } else {
+                targets.insert(package, package);
+            }
+            for (const QString &dependency : dependencies.value(package)) {
+                auto it = unitOf.constFind(dependency);
+                if (it != unitOf.constEnd() && *it != unit) {
+                    needed.insert(*it);
+                }
+            }
+        }
+        blockers[unit] = needed.size();
+        for (int dependency : needed) {
+            dependents[dependency].append(unit);
+        }
+    }
+
+    // Units ready to install, in installation order
+    std::set<int> ready;
+    for (int unit = 0; unit < unitCount; ++unit) {
+        if (unverified[unit] == 0 && blockers[unit] == 0) {
+            ready.insert(unit);
+        }
+    }
+
+    // Verified files taken off the queue and not yet installed
+    QHash<QString, qint64> waiting;
+    qint64 waitingBytes = 0;
+    auto accept = [&](const Item &item) {
+        targets.insert(item.package, item.path);
+        waiting.insert(item.package, item.size);
+        waitingBytes += item.size;
+        int unit = unitOf.value(item.package);
+        if (--unverified[unit] == 0 && blockers[unit] == 0) {
+            ready.insert(unit);
+        }
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    int installedUnits = 0;
+    int installedPackages = 0;
+    Item item;
+
+    while (installedUnits < unitCount) {
+        if (isStopped()) {
+            return false;
+        }
+
+        if (ready.empty()) {
+            if (verified.pop(item)) {
+                accept(item);
+                continue;
+            }
+            if (isStopped()) {
+                return false;
+            }
+
+            // Both stages finished, so the rest was never in the archive
+            QStringList missing;
+            for (auto it = bundled.constBegin(); it != bundled.constEnd(); ++it) {
+                if (!targets.contains(*it)) {
+                    missing.append(*it);
+                }
+            }
+            abort(QString("软件包中缺少文件: %1").arg(missing.join(", ")));
+            return false;
+        }
+
+        // Anything else verified meanwhile joins the same call, up to a
+        // limit so a slow install still holds back extraction
+        while (waiting.size() < kMaxWaitingItems && waitingBytes < kMaxWaitingBytes
+                && verified.tryPop(item)) {
+            accept(item);
+        }
+
+        QStringList names;
+        QStringList files;
+        QList<int> batch;
+        for (int unit : ready) {
+            batch.append(unit);
+            for (const QString &package : units[unit]) {
+                names.append(package);
+                files.append(targets.value(package));
+            }
+        }
+        ready.clear();
+
+        if (installedPackages == 0) {
+            logger->info(QString("首批软件包开始安装，距流水线启动 %1 ms").arg(timer.elapsed()));
+        }
+        emit packageStarted(names.join(", "), offset + installedPackages + 1, total);
+        emit logMessage(QString("\n[%1/%2] 安装 %3 个软件包: %4...\n")
+                        .arg(offset + installedPackages + 1).arg(total)
+                        .arg(names.size()).arg(names.join(", ")));
+
+        if (!packageManager.installPackages(files)) {
+            abort(QString("安装失败 - %1").arg(packageManager.getErrorMessage()));
+            return false;
+        }
+
+        // Installed files are no longer needed, so free their space now
+        for (const QString &name : names) {
+            if (bundled.contains(name)) {
+                QFile::remove(targets.value(name));
+                waitingBytes -= waiting.take(name);
+            }
+        }
+
+        for (int unit : batch) {
+            ++installedUnits;
+            for (int dependent : dependents[unit]) {
+                if (--blockers[dependent] == 0 && unverified[dependent] == 0) {
+                    ready.insert(dependent);
+                }
+            }
+        }
+        installedPackages += names.size();
+        emit progressChanged((offset + installedPackages) * 100 / total);
+        for (const QString &name : names) {
+            emit logMessage(QString("✓ %1 安装成功\n").arg(name));
+        }
+    }
+    return true;
+}
+
+bool InstallPipeline::isStopped() const {
+    return aborted || (cancelFlag && *cancelFlag);
+}
+
+void InstallPipeline::abort(const QString &message) {
+    {
+        QMutexLocker locker(&errorMutex);
+        if (errorMessage.isEmpty()) {
+            errorMessage = message;
+            logger->error(message);
+        }
+    }
+    aborted = true;
+
+    // Wake stages blocked on either queue
+    extracted.close();
+    verified.close();
+}
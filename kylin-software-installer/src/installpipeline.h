@@ -0,0 +1,104 @@
+#ifndef INSTALLPIPELINE_H
+#define INSTALLPIPELINE_H
+
+#include "boundedqueue.h"
+#include "packagetable.h"
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <atomic>
+#include <memory>
+
+class Logger;
+class PackageManager;
+class QTemporaryDir;
+
+// Extracts, verifies and installs the planned packages of a bundle in
+// three overlapped stages joined by bounded queues:
+//
+//   extract  streams package files out of the archive into a work
+//            directory; indexed archives in installation order, tar.gz
+//            in archive order
+//   verify   hashes each file against metadata.json (and the v2 TOC)
+//   install  hands each dependency unit to the package manager as soon
+//            as its members are verified and its dependencies installed
+//
+// Extract and verify run on their own threads, install on the calling
+// thread. Each queue holds only a few packages, so a fast stage waits
+// for a slow one instead of running ahead; the first install starts once
+// the first unit is through, however large the bundle. Package files are
+// deleted as soon as they are installed.
+class InstallPipeline : public QObject {
+    Q_OBJECT
+
+public:
+    InstallPipeline(std::shared_ptr<Logger> logger, PackageManager &packageManager,
+                    QObject *parent = nullptr);
+    ~InstallPipeline();
+
+    // Stop at the next safe point once *flag becomes true
+    void setCancelFlag(const std::atomic<bool> *flag);
+
+    // Create the work directory under parent instead of the system temp
+    // directory (see DiskSpacePlanner)
+    void setWorkDirectory(const QString &parent);
+
+    // Report packages as offset + n out of total, for runs that install
+    // one part of a larger plan
+    void setProgressRange(int offset, int total);
+
+    // Install units (see DependencyAnalyzer::getInstallationUnits) with
+    // the given edges among their packages. Bundled packages come from
+    // the archive at packagePath, the rest from the package manager's
+    // repositories. Runs once per pipeline.
+    bool run(const QString &packagePath, const PackageTable &bundle,
+             const QList<QStringList> &units,
+             const QMap<QString, QStringList> &dependencies);
+
+    // Get error message
+    QString getErrorMessage() const;
+
+signals:
+    void packageStarted(const QString &package, int index, int total);
+    void progressChanged(int value);
+    void logMessage(const QString &message);
+
+private:
+    // One package file on its way through the stages
+    struct Item {
+        QString package;
+        QString path;           // file in the work directory
+        QString checksum;       // from metadata.json, normalized
+        QString entryDigest;    // from a v2 TOC
+        qint64 size = 0;        // bytes written
+    };
+
+    void extractStage(const QString &packagePath, const QStringList &entries);
+    void verifyStage();
+    bool installStage(const QList<QStringList> &units,
+                      const QMap<QString, QStringList> &dependencies);
+    bool isStopped() const;
+    void abort(const QString &message);
+
+    std::shared_ptr<Logger> logger;
+    PackageManager &packageManager;
+    const std::atomic<bool> *cancelFlag;
+    std::atomic<bool> aborted;
+    QString workParent;
+    std::unique_ptr<QTemporaryDir> workDir;
+    int progressOffset;
+    int progressTotal;
+    QHash<QString, Item> items;         // by entry name; fixed before the stages start
+    QSet<QString> bundled;
+    BoundedQueue<Item> extracted;
+    BoundedQueue<Item> verified;
+    mutable QMutex errorMutex;
+    QString errorMessage;
+};
+
+#endif // INSTALLPIPELINE_H
@@ -1,7 +1,6 @@
 #include "installscreen.h"
-#include "packageparser.h"
-#include "packagemanager.h"
-#include "dependencyanalyzer.h"
+#include "installworker.h"
+#include "logviewmodel.h"
 #include "logger.h"
 
 #include <QVBoxLayout>
@@ -9,23 +8,66 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QProgressBar>
-#include <QTextEdit>
+#include <QListView>
+#include <QScrollBar>
 #include <QFont>
-#include <QThread>
 
-InstallScreen::InstallScreen(std::shared_ptr<Logger> logger, QWidget *parent)
+namespace {
+
+// Lines kept in the install log view; older ones scroll out
+const int kLogViewLines = 10000;
+
+} // namespace
+
+InstallScreen::InstallScreen(std::shared_ptr<Logger> logger,
+                             std::shared_ptr<PackageSession> session,
+                             QWidget *parent)
     : QWidget(parent)
     , logger(logger)
+    , session(session)
+    , logModel(new LogViewModel(kLogViewLines, this))
+    , followLog(true)
+    , worker(new InstallWorker(logger, session))
     , isInstalling(false)
 {
     initializeUI();
+
+    worker->moveToThread(&workerThread);
+    connect(&workerThread, &QThread::finished, worker, &QObject::deleteLater);
+    connect(worker, &InstallWorker::stageChanged, statusLabel, &QLabel::setText);
+    connect(worker, &InstallWorker::packageStarted, this, &InstallScreen::onPackageStarted);
+    connect(worker, &InstallWorker::progressChanged, this, &InstallScreen::updateProgress);
+    connect(worker, &InstallWorker::logMessage, this, &InstallScreen::appendLog);
+    connect(worker, &InstallWorker::finished, this, &InstallScreen::onWorkerFinished);
+    workerThread.start();
+}
+
+InstallScreen::~InstallScreen() {
+    // Quit only once the current run has returned: quit() would also end
+    // the event loop a package manager command waits in, and the command
+    // would be killed mid-transaction
+    worker->cancel();
+    QMetaObject::invokeMethod(worker, [this]() { workerThread.quit(); }, Qt::QueuedConnection);
+    workerThread.wait();
 }
 
 void InstallScreen::startInstall(const QString &packagePath) {
+    if (isInstalling) {
+        return;
+    }
+
     currentPackagePath = packagePath;
     isInstalling = true;
+
+    logModel->clear();
+    followLog = true;
+    progressBar->setValue(0);
+    currentPackageLabel->setText("准备安装...");
+    statusLabel->setText("状态: 初始化中...");
     cancelButton->setEnabled(true);
-    performInstallation();
+
+    QMetaObject::invokeMethod(worker, [this, packagePath]() { worker->run(packagePath); },
+                              Qt::QueuedConnection);
 }
 
 void InstallScreen::initializeUI() {
@@ -64,11 +106,14 @@ void InstallScreen::initializeUI() {
     logLabel->setFont(logFont);
     mainLayout->addWidget(logLabel);
 
-    logOutput = new QTextEdit(this);
-    logOutput->setReadOnly(true);
+    // Virtualized: only visible rows are laid out, each one line high
+    logOutput = new QListView(this);
+    logOutput->setModel(logModel);
+    logOutput->setUniformItemSizes(true);
+    logOutput->setSelectionMode(QAbstractItemView::ExtendedSelection);
     logOutput->setMinimumHeight(200);
     logOutput->setStyleSheet(
-        "QTextEdit {"
+        "QListView {"
         "  background-color: #1e1e1e;"
         "  color: #00ff00;"
         "  font-family: 'Courier New';"
@@ -77,6 +122,17 @@ void InstallScreen::initializeUI() {
         "  border-radius: 4px;"
         "}"
     );
+
+    // Follow new lines only while the view is scrolled to the bottom
+    connect(logModel, &QAbstractItemModel::rowsAboutToBeInserted, this, [this]() {
+        QScrollBar *bar = logOutput->verticalScrollBar();
+        followLog = bar->value() == bar->maximum();
+    });
+    connect(logModel, &QAbstractItemModel::rowsInserted, this, [this]() {
+        if (followLog) {
+            logOutput->scrollToBottom();
+        }
+    });
     mainLayout->addWidget(logOutput);
 
     // Cancel button
@@ -94,94 +150,22 @@ void InstallScreen::initializeUI() {
     setLayout(mainLayout);
 }
 
-void InstallScreen::performInstallation() {
-    logOutput->clear();
-    appendLog("开始安装软件包...\n");
-
-    PackageParser parser(logger);
-    if (!parser.parsePackage(currentPackagePath)) {
-        appendLog(QString("错误: 解析软件包失败 - %1\n").arg(parser.getErrorMessage()));
-        statusLabel->setText("状态: 安装失败");
-        isInstalling = false;
-        emit installCompleted(false);
-        return;
-    }
-
-    PackageMetadata metadata = parser.getMetadata();
-    QMap<QString, QStringList> dependencies = parser.getDependencies();
-
-    appendLog(QString("软件包信息: %1 (%2)\n").arg(metadata.targetSystem, metadata.targetArchitecture));
-    appendLog(QString("包含 %1 个软件包\n\n").arg(metadata.packages.size()));
-
-    // Analyze dependencies
-    DependencyAnalyzer analyzer(logger);
-    QStringList packageNames;
-    for (const PackageInfo &pkg : metadata.packages) {
-        packageNames.append(pkg.name);
-    }
-
-    QStringList installOrder = analyzer.getInstallationOrder(packageNames, dependencies);
-    if (installOrder.isEmpty()) {
-        appendLog("错误: 依赖分析失败\n");
-        statusLabel->setText("状态: 安装失败");
-        isInstalling = false;
-        emit installCompleted(false);
-        return;
-    }
-
-    appendLog(QString("安装顺序: %1\n\n").arg(installOrder.join(" -> ")));
+bool InstallScreen::isRunning() const {
+    return isInstalling;
+}
 
-    // Initialize package manager
-    PackageManager pkgManager(logger);
-    if (pkgManager.detectPackageManager() == PackageManagerType::Unknown) {
-        appendLog("错误: 无法检测到包管理器\n");
-        statusLabel->setText("状态: 安装失败");
-        isInstalling = false;
-        emit installCompleted(false);
+void InstallScreen::cancel() {
+    if (!isInstalling) {
         return;
     }
-
-    appendLog("开始安装软件包...\n");
-
-    int totalPackages = installOrder.size();
-    int installedCount = 0;
-
-    for (const QString &package : installOrder) {
-        if (!isInstalling) {
-            appendLog("\n用户取消了安装\n");
-            statusLabel->setText("状态: 已取消");
-            emit installCompleted(false);
-            return;
-        }
-
-        installedCount++;
-        currentPackageLabel->setText(QString("正在安装: %1 (%2/%3)").arg(package).arg(installedCount).arg(totalPackages));
-        appendLog(QString("\n[%1/%2] 安装 %3...\n").arg(installedCount).arg(totalPackages).arg(package));
-
-        // Simulate installation (in real implementation, would call pkgManager.installPackage)
-        int progress = (installedCount * 100) / totalPackages;
-        progressBar->setValue(progress);
-        statusLabel->setText(QString("状态: 安装中 (%1%)").arg(progress));
-
-        // Simulate work
-        QThread::msleep(500);
-        appendLog(QString("✓ %1 安装成功\n").arg(package));
-    }
-
-    progressBar->setValue(100);
-    statusLabel->setText("状态: 安装完成");
-    currentPackageLabel->setText("所有软件包已安装");
-    appendLog("\n✓ 所有软件包安装完成！\n");
-
-    isInstalling = false;
+    logger->info("用户取消安装");
+    worker->cancel();
     cancelButton->setEnabled(false);
-    emit installCompleted(true);
+    statusLabel->setText("状态: 正在取消...");
 }
 
 void InstallScreen::onCancelClicked() {
-    logger->info("用户取消安装");
-    isInstalling = false;
-    cancelButton->setEnabled(false);
+    cancel();
 }
 
 void InstallScreen::updateProgress(int value) {
@@ -189,9 +173,22 @@ void InstallScreen::updateProgress(int value) {
 }
 
 void InstallScreen::appendLog(const QString &message) {
-    logOutput->append(message);
-    // Auto-scroll to bottom
-    QTextCursor cursor = logOutput->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    logOutput->setTextCursor(cursor);
+    // Coalesced by the model and shown at most once per frame
+    logModel->appendText(message);
+}
+
+void InstallScreen::onPackageStarted(const QString &package, int index, int total) {
+    currentPackageLabel->setText(QString("正在安装: %1 (%2/%3)").arg(package).arg(index).arg(total));
+}
+
+void InstallScreen::onWorkerFinished(bool success, bool cancelled) {
+    Q_UNUSED(cancelled);
+
+    isInstalling = false;
+    logModel->flush();
+    cancelButton->setEnabled(false);
+    if (success) {
+        currentPackageLabel->setText("所有软件包已安装");
+    }
+    emit installCompleted(success);
 }
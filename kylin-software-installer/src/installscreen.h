@@ -2,22 +2,35 @@
 #define INSTALLSCREEN_H
 
 #include <QWidget>
+#include <QThread>
 #include <memory>
 
 class QProgressBar;
 class QLabel;
-class QTextEdit;
+class QListView;
 class QPushButton;
 class Logger;
+class PackageSession;
+class InstallWorker;
+class LogViewModel;
 
 class InstallScreen : public QWidget {
     Q_OBJECT
 
 public:
-    explicit InstallScreen(std::shared_ptr<Logger> logger, QWidget *parent = nullptr);
+    explicit InstallScreen(std::shared_ptr<Logger> logger,
+                           std::shared_ptr<PackageSession> session,
+                           QWidget *parent = nullptr);
+    ~InstallScreen();
 
     void startInstall(const QString &packagePath);
 
+    // Whether an install is in progress
+    bool isRunning() const;
+
+    // Ask the running install to stop at the next safe point
+    void cancel();
+
 signals:
     void installCompleted(bool success);
 
@@ -25,20 +38,27 @@ private slots:
     void onCancelClicked();
     void updateProgress(int value);
     void appendLog(const QString &message);
+    void onPackageStarted(const QString &package, int index, int total);
+    void onWorkerFinished(bool success, bool cancelled);
 
 private:
     void initializeUI();
-    void performInstallation();
 
     std::shared_ptr<Logger> logger;
+    std::shared_ptr<PackageSession> session;
     QString currentPackagePath;
 
     QLabel *currentPackageLabel;
     QProgressBar *progressBar;
     QLabel *statusLabel;
-    QTextEdit *logOutput;
+    QListView *logOutput;
+    LogViewModel *logModel;
+    bool followLog;
     QPushButton *cancelButton;
 
+    // Install pipeline runs here so the UI stays responsive
+    QThread workerThread;
+    InstallWorker *worker;
     bool isInstalling;
 };
 
@@ -0,0 +1,375 @@
+#include "installworker.h"
+#include "packagesession.h"
+#include "packagemanager.h"
+#include "systemcapabilities.h"
+#include "dependencyanalyzer.h"
+#include "diskspaceplanner.h"
+#include "installpipeline.h"
+#include "logger.h"
+
+#include <QHash>
+#include <QSettings>
+#include <QSet>
+
+InstallWorker::InstallWorker(std::shared_ptr<Logger> logger,
+                             std::shared_ptr<PackageSession> session,
+                             QObject *parent)
+    : QObject(parent)
+    , logger(logger)
+    , session(session)
+    , cancelRequested(false)
+{
+}
+
+void InstallWorker::cancel() {
+    cancelRequested = true;
+}
+
+bool InstallWorker::isCancelled() const {
+    return cancelRequested;
+}
+
+void InstallWorker::run(const QString &packagePath) {
+    cancelRequested = false;
+
+    bool success = execute(packagePath);
+    bool cancelled = !success && cancelRequested;
+    if (cancelled) {
+        logger->info("安装已取消");
+        emit logMessage("\n用户取消了安装\n");
+        emit stageChanged("状态: 已取消");
+    }
+
+    emit finished(success, cancelled);
+}
+
+bool InstallWorker::execute(const QString &packagePath) {
+    emit logMessage("开始安装软件包...\n");
+
+    logger->setStage("解析");
+    if (!session->open(packagePath)) {
+        return fail(QString("错误: 解析软件包失败 - %1\n").arg(session->getErrorMessage()));
+    }
+
+    PackageMetadata metadata = session->getMetadata();
+    QMap<QString, QStringList> dependencies = session->getDependencies();
+
+    emit logMessage(QString("软件包信息: %1 (%2)\n").arg(metadata.targetSystem, metadata.targetArchitecture));
+    emit logMessage(QString("包含 %1 个软件包\n\n").arg(metadata.packages.size()));
+
+    // Analyze dependencies
+    logger->setStage("依赖分析");
+    DependencyAnalyzer analyzer(logger);
+    QStringList packageNames;
+    for (const PackageInfo &pkg : metadata.packages) {
+        packageNames.append(pkg.name);
+    }
+
+    ResolvedDependencies resolved = analyzer.resolveConstraints(metadata.packages, dependencies,
+                                                                session->getProvides());
+    if (!resolved.unsatisfied.isEmpty()) {
+        return fail(QString("错误: 依赖版本无法满足:\n%1\n").arg(resolved.unsatisfied.join("\n")));
+    }
+
+    // Only what the system does not already satisfy is extracted and installed
+    InstallPlan plan = analyzer.planInstallation(packageNames, resolved);
+    if (!plan.skipped.isEmpty()) {
+        emit logMessage(QString("已满足，跳过 %1 个软件包: %2\n").arg(plan.skipped.size()).arg(plan.skipped.join(", ")));
+    }
+    if (!plan.upgrade.isEmpty()) {
+        emit logMessage(QString("需要升级 %1 个软件包: %2\n").arg(plan.upgrade.size()).arg(plan.upgrade.join(", ")));
+    }
+    if (plan.install.isEmpty()) {
+        emit progressChanged(100);
+        emit stageChanged("状态: 安装完成");
+        emit logMessage("\n✓ 所有软件包均已安装，无需操作\n");
+        return true;
+    }
+
+    // Cycles are condensed into units rather than rejected, so point out
+    // any real dependency loop
+    QList<QStringList> levels = analyzer.getInstallationLevels(plan.install, plan.dependencies);
+    QList<QStringList> units = analyzer.getInstallationUnits(plan.install, plan.dependencies);
+    for (const QStringList &unit : units) {
+        if (unit.size() > 1) {
+            emit logMessage(QString("警告: 循环依赖，将在同一事务中安装: %1\n").arg(unit.join(", ")));
+        }
+    }
+
+    for (int i = 0; i < levels.size(); ++i) {
+        emit logMessage(QString("第 %1 层: %2\n").arg(i + 1).arg(levels[i].join(", ")));
+    }
+    emit logMessage("\n");
+
+    if (cancelRequested) {
+        return false;
+    }
+
+    // The system probe is shared and runs once per process
+    std::shared_ptr<SystemCapabilities> capabilities = SystemCapabilities::instance(logger);
+    if (capabilities->packageManager() == PackageManagerType::Unknown) {
+        return fail("错误: 无法检测到包管理器\n");
+    }
+    emit logMessage(QString("包管理器: %1\n").arg(capabilities->describe()));
+
+    PackageManager pkgManager(logger);
+    pkgManager.setCancelFlag(&cancelRequested);
+    pkgManager.setOutputHandler([this](const QString &line) {
+        emit logMessage(line + "\n");
+    });
+
+    if (cancelRequested) {
+        return false;
+    }
+
+    // A payload already on disk needs neither room nor extraction
+    QSettings settings("Kylin", "SoftwareInstaller");
+    if (!session->hasPayload()) {
+        DiskPlan disk;
+        if (!planDiskSpace(levels, disk)) {
+            return false;
+        }
+        // Only the pipeline can extract one wave at a time; otherwise it
+        // installs in many transactions, so a single transaction wins
+        bool singleTransaction = settings.value("install/singleTransaction", true).toBool();
+        if (disk.lowSpace || (!singleTransaction && settings.value("install/pipelined", true).toBool())) {
+            return installPipelined(pkgManager, packagePath, plan, levels, units, disk);
+        }
+        session->setWorkDirectory(disk.directory);
+    }
+
+    // Unpack (and verify) only the bundled packages in the plan
+    logger->setStage("解压");
+    emit stageChanged("状态: 解压中...");
+    emit logMessage("解压软件包...\n");
+    if (!session->ensureExtracted(plan.install)) {
+        return fail(QString("错误: 解压软件包失败 - %1\n").arg(session->getErrorMessage()));
+    }
+
+    emit logMessage("开始安装软件包...\n");
+
+    // Bundled packages install from their file; anything else is left to
+    // the package manager's repositories
+    QMap<QString, QString> packageFiles;
+    for (const PackageInfo &pkg : metadata.packages) {
+        packageFiles.insert(pkg.name, session->getExtractDir() + "/packages/" + pkg.filename);
+    }
+
+    QList<QStringList> levelTargets;
+    for (const QStringList &level : levels) {
+        QStringList targets;
+        for (const QString &package : level) {
+            targets.append(packageFiles.value(package, package));
+        }
+        levelTargets.append(targets);
+    }
+
+    if (cancelRequested) {
+        return false;
+    }
+
+    logger->setStage("安装");
+    bool ok = settings.value("install/singleTransaction", true).toBool()
+        ? installInOneTransaction(pkgManager, levels, levelTargets)
+        : installByLevel(pkgManager, levels, levelTargets);
+    if (!ok) {
+        return false;
+    }
+
+    emit progressChanged(100);
+    emit stageChanged("状态: 安装完成");
+    emit logMessage("\n✓ 所有软件包安装完成！\n");
+    return true;
+}
+
+bool InstallWorker::planDiskSpace(const QList<QStringList> &levels, DiskPlan &disk) {
+    PackageMetadata metadata = session->getMetadata();
+    QHash<QString, qint64> sizes;
+    for (int row = 0; row < metadata.packages.size(); ++row) {
+        sizes.insert(metadata.packages.name(row), metadata.packages.packageSize(row));
+    }
+
+    // Each level is one install wave
+    qint64 totalBytes = 0;
+    qint64 largestWave = 0;
+    for (const QStringList &level : levels) {
+        qint64 waveBytes = 0;
+        for (const QString &package : level) {
+            waveBytes += sizes.value(package);
+        }
+        totalBytes += waveBytes;
+        largestWave = qMax(largestWave, waveBytes);
+    }
+
+    // Package sizes are optional in metadata.json
+    if (totalBytes == 0) {
+        totalBytes = metadata.totalSize;
+        largestWave = metadata.totalSize;
+    }
+
+    DiskSpacePlanner planner(logger);
+    if (!planner.plan(totalBytes, largestWave, disk)) {
+        return fail(QString("错误: %1\n").arg(planner.getErrorMessage()));
+    }
+    if (disk.lowSpace) {
+        emit logMessage(QString("磁盘空间不足，将逐层解压到 %1，每个软件包安装后立即删除\n").arg(disk.directory));
+    }
+    return true;
+}
+
+bool InstallWorker::installPipelined(PackageManager &pkgManager, const QString &packagePath,
+                                     const InstallPlan &plan, const QList<QStringList> &levels,
+                                     const QList<QStringList> &units, const DiskPlan &disk) {
+    logger->setStage("安装");
+    emit stageChanged("状态: 安装中 (0%)");
+    emit logMessage("边解压、边校验、边安装...\n");
+
+    // In low-space mode a wave is only extracted once the previous one is
+    // installed and its files deleted
+    QList<QList<QStringList>> waves;
+    if (disk.lowSpace) {
+        QHash<QString, int> levelOf;
+        for (int i = 0; i < levels.size(); ++i) {
+            for (const QString &package : levels[i]) {
+                levelOf.insert(package, i);
+            }
+        }
+        waves.reserve(levels.size());
+        for (int i = 0; i < levels.size(); ++i) {
+            waves.append(QList<QStringList>());
+        }
+        for (const QStringList &unit : units) {
+            waves[levelOf.value(unit.first())].append(unit);
+        }
+    } else {
+        waves.append(units);
+    }
+
+    PackageTable bundle = session->getMetadata().packages;
+    int installed = 0;
+    for (const QList<QStringList> &wave : waves) {
+        if (wave.isEmpty()) {
+            continue;
+        }
+
+        InstallPipeline pipeline(logger, pkgManager);
+        pipeline.setCancelFlag(&cancelRequested);
+        pipeline.setWorkDirectory(disk.directory);
+        pipeline.setProgressRange(installed, plan.install.size());
+        connect(&pipeline, &InstallPipeline::packageStarted, this, &InstallWorker::packageStarted);
+        connect(&pipeline, &InstallPipeline::logMessage, this, &InstallWorker::logMessage);
+        connect(&pipeline, &InstallPipeline::progressChanged, this, [this](int value) {
+            emit progressChanged(value);
+            emit stageChanged(QString("状态: 安装中 (%1%)").arg(value));
+        });
+
+        if (!pipeline.run(packagePath, bundle, wave, plan.dependencies)) {
+            if (cancelRequested) {
+                return false;
+            }
+            return fail(QString("错误: %1\n").arg(pipeline.getErrorMessage()));
+        }
+
+        for (const QStringList &unit : wave) {
+            installed += unit.size();
+        }
+    }
+
+    emit progressChanged(100);
+    emit stageChanged("状态: 安装完成");
+    emit logMessage("\n✓ 所有软件包安装完成！\n");
+    return true;
+}
+
+bool InstallWorker::installInOneTransaction(PackageManager &pkgManager,
+                                            const QList<QStringList> &levels,
+                                            const QList<QStringList> &levelTargets) {
+    // Dependency order still helps the package manager, so keep it
+    QStringList targets;
+    QSet<QString> packages;
+    for (int i = 0; i < levels.size(); ++i) {
+        targets.append(levelTargets[i]);
+        for (const QString &package : levels[i]) {
+            packages.insert(package);
+        }
+    }
+
+    int totalPackages = packages.size();
+    emit logMessage(QString("\n单事务安装 %1 个软件包...\n").arg(totalPackages));
+    emit stageChanged("状态: 安装中 (0%)");
+    if (targets.isEmpty()) {
+        return true;
+    }
+
+    // The transaction is not interrupted once started, which keeps the
+    // package database consistent
+    QSet<QString> seen;
+    QString current;
+    bool ok = pkgManager.installTransaction(targets, [&](const TransactionProgress &progress) {
+        if (packages.contains(progress.package) && progress.package != current) {
+            current = progress.package;
+            seen.insert(current);
+            emit packageStarted(current, seen.size(), totalPackages);
+            emit logMessage(QString("[%1/%2] %3\n").arg(seen.size()).arg(totalPackages).arg(progress.action));
+        }
+        emit progressChanged(progress.percent);
+        emit stageChanged(QString("状态: 安装中 (%1%)").arg(progress.percent));
+    });
+
+    if (!ok) {
+        return fail(QString("错误: 安装失败 - %1\n").arg(pkgManager.getErrorMessage()));
+    }
+
+    for (const QStringList &level : levels) {
+        for (const QString &package : level) {
+            emit logMessage(QString("✓ %1 安装成功\n").arg(package));
+        }
+    }
+    return true;
+}
+
+bool InstallWorker::installByLevel(PackageManager &pkgManager,
+                                   const QList<QStringList> &levels,
+                                   const QList<QStringList> &levelTargets) {
+    int totalPackages = 0;
+    for (const QStringList &level : levels) {
+        totalPackages += level.size();
+    }
+    int installedCount = 0;
+
+    // One package manager call per level: its members do not depend on
+    // each other, so a single transaction installs them together
+    for (int i = 0; i < levels.size(); ++i) {
+        if (cancelRequested) {
+            return false;
+        }
+
+        const QStringList &level = levels[i];
+        const QStringList &targets = levelTargets[i];
+
+        emit packageStarted(level.join(", "), installedCount + 1, totalPackages);
+        emit logMessage(QString("\n[%1/%2] 安装第 %3 层 (%4 个软件包): %5...\n")
+                        .arg(installedCount + 1).arg(totalPackages)
+                        .arg(i + 1).arg(level.size()).arg(level.join(", ")));
+
+        if (!targets.isEmpty() && !pkgManager.installPackages(targets)) {
+            return fail(QString("错误: 安装失败 - %1\n").arg(pkgManager.getErrorMessage()));
+        }
+
+        installedCount += level.size();
+        int progress = (installedCount * 100) / totalPackages;
+        emit progressChanged(progress);
+        emit stageChanged(QString("状态: 安装中 (%1%)").arg(progress));
+        for (const QString &package : level) {
+            emit logMessage(QString("✓ %1 安装成功\n").arg(package));
+        }
+    }
+    return true;
+}
+
+bool InstallWorker::fail(const QString &message) {
+    logger->error(message.trimmed());
+    emit logMessage(message);
+    emit stageChanged("状态: 安装失败");
+    return false;
+}
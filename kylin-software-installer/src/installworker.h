@@ -0,0 +1,67 @@
+#ifndef INSTALLWORKER_H
+#define INSTALLWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <memory>
+
+class Logger;
+class PackageSession;
+class PackageManager;
+struct InstallPlan;
+struct DiskPlan;
+
+// Runs the whole install pipeline (parse, dependency analysis, package
+// manager detection, extraction and the install loop) on a worker
+// thread. Unless the payload is already on disk, extraction,
+// verification and installation overlap (see InstallPipeline), in a work
+// directory chosen by free space (see DiskSpacePlanner). Progress is
+// reported through signals, which reach the UI as queued calls; cancel()
+// may be called from any thread.
+class InstallWorker : public QObject {
+    Q_OBJECT
+
+public:
+    explicit InstallWorker(std::shared_ptr<Logger> logger,
+                           std::shared_ptr<PackageSession> session,
+                           QObject *parent = nullptr);
+
+    // Ask the running install to stop at the next safe point
+    void cancel();
+
+    // Check if cancellation was requested
+    bool isCancelled() const;
+
+public slots:
+    // Install the bundle at packagePath; emits finished() when done
+    void run(const QString &packagePath);
+
+signals:
+    void stageChanged(const QString &stage);
+    void packageStarted(const QString &package, int index, int total);
+    void progressChanged(int value);
+    void logMessage(const QString &message);
+    void finished(bool success, bool cancelled);
+
+private:
+    bool execute(const QString &packagePath);
+    bool planDiskSpace(const QList<QStringList> &levels, DiskPlan &disk);
+    bool installPipelined(PackageManager &pkgManager, const QString &packagePath,
+                          const InstallPlan &plan, const QList<QStringList> &levels,
+                          const QList<QStringList> &units, const DiskPlan &disk);
+    bool installInOneTransaction(PackageManager &pkgManager,
+                                 const QList<QStringList> &levels,
+                                 const QList<QStringList> &levelTargets);
+    bool installByLevel(PackageManager &pkgManager,
+                        const QList<QStringList> &levels,
+                        const QList<QStringList> &levelTargets);
+    bool fail(const QString &message);
+
+    std::shared_ptr<Logger> logger;
+    std::shared_ptr<PackageSession> session;
+    std::atomic<bool> cancelRequested;
+};
+
+#endif // INSTALLWORKER_H
@@ -0,0 +1,384 @@
+#include "jsonstreamreader.h"
+
+#include <cstring>
+
+namespace {
+
+// Containers nested deeper than this are rejected
+const int kMaxDepth = 256;
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+} // namespace
+
+bool JsonString::operator==(const char *text) const {
+    int length = static_cast<int>(std::strlen(text));
+    return length == size && std::memcmp(data, text, size) == 0;
+}
+
+QString JsonString::toString() const {
+    return QString::fromUtf8(data, size);
+}
+
+JsonStreamReader::JsonStreamReader(const char *data, qint64 size)
+    : begin(data)
+    , pos(data)
+    , end(data + size)
+{
+    // A UTF-8 byte order mark is allowed before the document
+    if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        pos += 3;
+    }
+}
+
+JsonStreamReader::Type JsonStreamReader::peek() {
+    skipWhitespace();
+    if (pos >= end || hasError()) {
+        return Type::Invalid;
+    }
+    switch (*pos) {
+    case '{':
+        return Type::Object;
+    case '[':
+        return Type::Array;
+    case '"':
+        return Type::String;
+    case 't':
+    case 'f':
+        return Type::Bool;
+    case 'n':
+        return Type::Null;
+    default:
+        return (*pos == '-' || isDigit(*pos)) ? Type::Number : Type::Invalid;
+    }
+}
+
+bool JsonStreamReader::enterObject() {
+    if (!expect('{')) {
+        return false;
+    }
+    firstItem.append(true);
+    return firstItem.size() <= kMaxDepth || fail("嵌套过深");
+}
+
+bool JsonStreamReader::enterArray() {
+    if (!expect('[')) {
+        return false;
+    }
+    firstItem.append(true);
+    return firstItem.size() <= kMaxDepth || fail("嵌套过深");
+}
+
+bool JsonStreamReader::nextMember(JsonString &key) {
+    if (!nextItem('}')) {
+        return false;
+    }
+    skipWhitespace();
+    if (pos >= end || *pos != '"') {
+        return fail("缺少成员名");
+    }
+    return scanString(key) && expect(':');
+}
+
+bool JsonStreamReader::nextElement() {
+    return nextItem(']');
+}
+
+bool JsonStreamReader::readString(JsonString &value) {
+    skipWhitespace();
+    if (pos >= end || *pos != '"') {
+        return fail("应为字符串");
+    }
+    return scanString(value);
+}
+
+bool JsonStreamReader::readInt64(qint64 &value) {
+    skipWhitespace();
+    JsonString text;
+    if (!scanNumber(text)) {
+        return false;
+    }
+
+    // Plain integers are the common case; anything else goes via double
+    bool integral = true;
+    for (int i = 0; i < text.size; ++i) {
+        if (!isDigit(text.data[i]) && !(i == 0 && text.data[i] == '-')) {
+            integral = false;
+            break;
+        }
+    }
+    bool ok = false;
+    QByteArray raw = QByteArray::fromRawData(text.data, text.size);
+    value = integral ? raw.toLongLong(&ok) : static_cast<qint64>(raw.toDouble(&ok));
+    return ok || fail("数值超出范围");
+}
+
+bool JsonStreamReader::skipValue() {
+    switch (peek()) {
+    case Type::Object: {
+        enterObject();
+        JsonString key;
+        while (nextMember(key)) {
+            if (!skipValue()) {
+                return false;
+            }
+        }
+        return !hasError();
+    }
+    case Type::Array:
+        enterArray();
+        while (nextElement()) {
+            if (!skipValue()) {
+                return false;
+            }
+        }
+        return !hasError();
+    case Type::String: {
+        JsonString value;
+        return scanString(value);
+    }
+    case Type::Number: {
+        JsonString text;
+        return scanNumber(text);
+    }
+    case Type::Bool:
+        return scanLiteral(*pos == 't' ? "true" : "false");
+    case Type::Null:
+        return scanLiteral("null");
+    default:
+        return fail("应为值");
+    }
+}
+
+bool JsonStreamReader::atEnd() {
+    skipWhitespace();
+    return pos >= end;
+}
+
+bool JsonStreamReader::hasError() const {
+    return !errorMessage.isEmpty();
+}
+
+QString JsonStreamReader::getErrorMessage() const {
+    return errorMessage;
+}
+
+void JsonStreamReader::skipWhitespace() {
+    while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) {
+        ++pos;
+    }
+}
+
+bool JsonStreamReader::expect(char c) {
+    skipWhitespace();
+    if (hasError() || pos >= end || *pos != c) {
+        return fail(QString("应为 '%1'").arg(c));
+    }
+    ++pos;
+    return true;
+}
+
+bool JsonStreamReader::nextItem(char close) {
+    if (hasError() || firstItem.isEmpty()) {
+        return false;
+    }
+    skipWhitespace();
+    if (pos < end && *pos == close) {
+        ++pos;
+        firstItem.removeLast();
+        return false;
+    }
+    if (!firstItem.last() && !expect(',')) {
+        return false;
+    }
+    firstItem.last() = false;
+    return true;
+}
+
+bool JsonStreamReader::scanString(JsonString &value) {
+    // pos is at the opening quote
+    const char *start = ++pos;
+    while (pos < end && *pos != '"' && *pos != '\\') {
+        if (static_cast<uchar>(*pos) < 0x20) {
+            return fail("字符串中有控制字符");
+        }
+        ++pos;
+    }
+    if (pos >= end) {
+        return fail("字符串未结束");
+    }
+    if (*pos == '"') {
+        // No escapes: hand out the text in place
+        value.data = start;
+        value.size = static_cast<int>(pos - start);
+        ++pos;
+        return true;
+    }
+
+    scratch.clear();
+    scratch.append(start, static_cast<int>(pos - start));
+    while (pos < end && *pos != '"') {
+        char c = *pos++;
+        if (static_cast<uchar>(c) < 0x20) {
+            return fail("字符串中有控制字符");
+        }
+        if (c != '\\') {
+            scratch.append(c);
+            continue;
+        }
+        if (pos >= end) {
+            break;
+        }
+        switch (char escape = *pos++) {
+        case '"':
+        case '\\':
+        case '/':
+            scratch.append(escape);
+            break;
+        case 'b':
+            scratch.append('\b');
+            break;
+        case 'f':
+            scratch.append('\f');
+            break;
+        case 'n':
+            scratch.append('\n');
+            break;
+        case 'r':
+            scratch.append('\r');
+            break;
+        case 't':
+            scratch.append('\t');
+            break;
+        case 'u': {
+            uint codePoint = 0;
+            for (int i = 0; i < 4; ++i) {
+                int digit = pos < end ? hexValue(*pos++) : -1;
+                if (digit < 0) {
+                    return fail("无效的 \\u 转义");
+                }
+                codePoint = codePoint * 16 + static_cast<uint>(digit);
+            }
+            // A high surrogate pairs with the \u escape after it
+            if (codePoint >= 0xD800 && codePoint < 0xDC00 && end - pos >= 6
+                    && pos[0] == '\\' && pos[1] == 'u') {
+                uint low = 0;
+                bool valid = true;
+                for (int i = 2; i < 6; ++i) {
+                    int digit = hexValue(pos[i]);
+                    valid = valid && digit >= 0;
+                    low = low * 16 + static_cast<uint>(qMax(digit, 0));
+                }
+                if (valid && low >= 0xDC00 && low < 0xE000) {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    pos += 6;
+                }
+            }
+            if (!appendCodePoint(codePoint)) {
+                return false;
+            }
+            break;
+        }
+        default:
+            return fail("无效的转义字符");
+        }
+    }
+    if (pos >= end) {
+        return fail("字符串未结束");
+    }
+    ++pos;
+    value.data = scratch.constData();
+    value.size = scratch.size();
+    return true;
+}
+
+bool JsonStreamReader::scanNumber(JsonString &text) {
+    const char *start = pos;
+    if (pos < end && *pos == '-') {
+        ++pos;
+    }
+    if (pos >= end || !isDigit(*pos)) {
+        return fail("应为数值");
+    }
+    while (pos < end && isDigit(*pos)) {
+        ++pos;
+    }
+    if (pos < end && *pos == '.') {
+        ++pos;
+        if (pos >= end || !isDigit(*pos)) {
+            return fail("无效的数值");
+        }
+        while (pos < end && isDigit(*pos)) {
+            ++pos;
+        }
+    }
+    if (pos < end && (*pos == 'e' || *pos == 'E')) {
+        ++pos;
+        if (pos < end && (*pos == '+' || *pos == '-')) {
+            ++pos;
+        }
+        if (pos >= end || !isDigit(*pos)) {
+            return fail("无效的数值");
+        }
+        while (pos < end && isDigit(*pos)) {
+            ++pos;
+        }
+    }
+    text.data = start;
+    text.size = static_cast<int>(pos - start);
+    return true;
+}
+
+bool JsonStreamReader::scanLiteral(const char *literal) {
+    int length = static_cast<int>(std::strlen(literal));
+    if (end - pos < length || std::memcmp(pos, literal, length) != 0) {
+        return fail("无效的字面量");
+    }
+    pos += length;
+    return true;
+}
+
+bool JsonStreamReader::appendCodePoint(uint codePoint) {
+    // Lone surrogates cannot be encoded as UTF-8
+    if (codePoint >= 0xD800 && codePoint < 0xE000) {
+        return fail("无效的代理项");
+    }
+    if (codePoint < 0x80) {
+        scratch.append(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        scratch.append(static_cast<char>(0xC0 | (codePoint >> 6)));
+        scratch.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        scratch.append(static_cast<char>(0xE0 | (codePoint >> 12)));
+        scratch.append(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        scratch.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        scratch.append(static_cast<char>(0xF0 | (codePoint >> 18)));
+        scratch.append(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        scratch.append(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        scratch.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    return true;
+}
+
+bool JsonStreamReader::fail(const QString &what) {
+    if (errorMessage.isEmpty()) {
+        errorMessage = QString("%1 (偏移 %2)").arg(what).arg(pos - begin);
+    }
+    return false;
+}
@@ -0,0 +1,80 @@
+#ifndef JSONSTREAMREADER_H
+#define JSONSTREAMREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// A string token. Points into the parsed buffer when the text has no
+// escapes, otherwise into the reader's scratch space, so it stays valid
+// only until the next call on the reader.
+struct JsonString {
+    const char *data = nullptr;
+    int size = 0;
+
+    bool operator==(const char *text) const;
+    QString toString() const;
+};
+
+// Pull parser over a UTF-8 JSON buffer (e.g. a memory-mapped manifest).
+// Walks the text once without building a document; the caller asks for
+// the values it wants and skips the rest.
+class JsonStreamReader {
+public:
+    enum class Type {
+        Object,
+        Array,
+        String,
+        Number,
+        Bool,
+        Null,
+        Invalid
+    };
+
+    JsonStreamReader(const char *data, qint64 size);
+
+    // Type of the next value, without consuming it
+    Type peek();
+
+    // Enter the object or array that is the next value
+    bool enterObject();
+    bool enterArray();
+
+    // Next member of the current object; false once it is closed
+    bool nextMember(JsonString &key);
+
+    // Step to the next element of the current array; false once it is closed
+    bool nextElement();
+
+    // Read a scalar that is the next value
+    bool readString(JsonString &value);
+    bool readInt64(qint64 &value);
+
+    // Skip the next value, nested ones included
+    bool skipValue();
+
+    // Only whitespace remains
+    bool atEnd();
+
+    bool hasError() const;
+    QString getErrorMessage() const;
+
+private:
+    void skipWhitespace();
+    bool expect(char c);
+    bool nextItem(char close);
+    bool scanString(JsonString &value);
+    bool scanNumber(JsonString &text);
+    bool scanLiteral(const char *literal);
+    bool appendCodePoint(uint codePoint);
+    bool fail(const QString &what);
+
+    const char *begin;
+    const char *pos;
+    const char *end;
+    QVector<bool> firstItem;    // per open container: no item read yet
+    QByteArray scratch;
+    QString errorMessage;
+};
+
+#endif // JSONSTREAMREADER_H
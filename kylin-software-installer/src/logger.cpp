@@ -1,23 +1,59 @@
 #include "logger.h"
 #include <QStandardPaths>
-#include <QDir>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QThread>
 #include <iostream>
 
-Logger::Logger() {
-    // Create log directory
-    QString logDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    QDir().mkpath(logDir);
-    
-    // Open log file
-    QString logFilePath = logDir + "/kylin-installer.log";
-    logFile.setFileName(logFilePath);
-    logFile.open(QIODevice::Append | QIODevice::Text);
+namespace {
+
+const int kRingCapacity = 8192;
+const int kPollMs = 20;
+const int kMaxBatch = 4096;
+
+LogFlushPolicy readPolicy() {
+    LogFlushPolicy policy;
+    QSettings settings("Kylin", "SoftwareInstaller");
+    policy.everyLines = settings.value("log/flushLines", policy.everyLines).toInt();
+    policy.intervalMs = qMax(1, settings.value("log/flushIntervalMs", policy.intervalMs).toInt());
+    policy.syncOnError = settings.value("log/syncOnError", policy.syncOnError).toBool();
+    policy.console = settings.value("log/console", policy.console).toBool();
+    policy.maxFileSize = qMax<qint64>(64 * 1024, settings.value("log/maxFileSize", policy.maxFileSize).toLongLong());
+    policy.maxFiles = qMax(1, settings.value("log/maxFiles", policy.maxFiles).toInt());
+    return policy;
+}
+
+} // namespace
+
+Logger::Logger()
+    : policy(readPolicy())
+    , ring(kRingCapacity)
+    , pushedCount(0)
+    , droppedCount(0)
+    , stopping(false)
+    , writtenCount(0)
+    , flushRequested(false)
+    , store(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation),
+            "kylin-installer", policy.maxFileSize, policy.maxFiles)
+    , stampSecond(-1)
+{
+    // Creates the log directory and re-indexes what a crash left behind
+    if (!store.open()) {
+        std::cerr << "无法打开日志文件: " << store.filePath().toStdString() << std::endl;
+    }
+
+    writer.reset(QThread::create([this]() { writerLoop(); }));
+    writer->start();
 }
 
 Logger::~Logger() {
-    if (logFile.isOpen()) {
-        logFile.close();
+    stopping = true;
+    {
+        QMutexLocker locker(&wakeMutex);
+        wakeup.wakeOne();
     }
+    writer->wait();
 }
 
 void Logger::debug(const QString &message) {
@@ -36,59 +72,223 @@ void Logger::error(const QString &message) {
     log(LogLevel::Error, message);
 }
 
-QString Logger::getLogFilePath() const {
-    return logFile.fileName();
+QString Logger::beginSession(const QString &package) {
+    QString id = QString("%1-%2")
+        .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"))
+        .arg(QCoreApplication::applicationPid());
+    {
+        QMutexLocker locker(&sessionMutex);
+        sessionId = id;
+    }
+
+    Record record;
+    record.kind = Record::SessionStart;
+    record.message = id;
+    record.package = package;
+    pushContext(std::move(record));
+    return id;
+}
+
+void Logger::setStage(const QString &stage) {
+    Record record;
+    record.kind = Record::StageChange;
+    record.message = stage;
+    pushContext(std::move(record));
+}
+
+QString Logger::currentSession() const {
+    QMutexLocker locker(&sessionMutex);
+    return sessionId;
 }
 
-QString Logger::getAllLogs() const {
-    QFile file(logFile.fileName());
-    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QString content = QString::fromUtf8(file.readAll());
-        file.close();
-        return content;
+void Logger::flush() {
+    quint64 target = pushedCount.load();
+
+    QMutexLocker locker(&wakeMutex);
+    while (writtenCount < target && !stopping) {
+        flushRequested = true;
+        wakeup.wakeOne();
+        written.wait(&wakeMutex);
     }
-    return QString();
+}
+
+LogPage Logger::query(const LogQuery &query) {
+    flush();
+
+    QMutexLocker locker(&fileMutex);
+    return store.query(query);
+}
+
+QString Logger::getLogFilePath() const {
+    return store.filePath();
 }
 
 void Logger::clearLogs() {
-    QMutexLocker locker(&mutex);
-    if (logFile.isOpen()) {
-        logFile.close();
-    }
-    logFile.open(QIODevice::WriteOnly | QIODevice::Text);
-    logFile.close();
-    logFile.open(QIODevice::Append | QIODevice::Text);
+    flush();
+
+    QMutexLocker locker(&fileMutex);
+    store.clear();
 }
 
 void Logger::log(LogLevel level, const QString &message) {
-    QMutexLocker locker(&mutex);
-    
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
-    QString levelStr = levelToString(level);
-    QString logMessage = QString("[%1] [%2] %3\n").arg(timestamp, levelStr, message);
-    
-    // Write to file
-    if (logFile.isOpen()) {
-        QTextStream stream(&logFile);
-        stream << logMessage;
-        logFile.flush();
+    // Hot path: no lock, no formatting, no I/O
+    Record record;
+    record.timestamp = QDateTime::currentMSecsSinceEpoch();
+    record.level = level;
+    record.message = message;
+
+    if (!ring.push(std::move(record))) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    pushedCount.fetch_add(1, std::memory_order_release);
+
+    // Errors are rare; get them on disk without waiting for the next poll
+    if (level == LogLevel::Error) {
+        QMutexLocker locker(&wakeMutex);
+        wakeup.wakeOne();
     }
-    
-    // Also print to console
-    std::cout << logMessage.toStdString();
+}
+
+void Logger::pushContext(Record record) {
+    // Context changes are rare and must not be dropped, so wait for room
+    record.timestamp = QDateTime::currentMSecsSinceEpoch();
+    while (!ring.push(record)) {
+        QThread::yieldCurrentThread();
+    }
+    pushedCount.fetch_add(1, std::memory_order_release);
 }
 
 QString Logger::levelToString(LogLevel level) const {
-    switch (level) {
-    case LogLevel::Debug:
-        return "DEBUG";
-    case LogLevel::Info:
-        return "INFO";
-    case LogLevel::Warning:
-        return "WARNING";
-    case LogLevel::Error:
-        return "ERROR";
-    default:
-        return "UNKNOWN";
+    return LogStore::levelName(level);
+}
+
+void Logger::writerLoop() {
+    QList<LogEntry> batch;
+    quint64 doneRecords = 0;
+    quint64 pendingRecords = 0;
+    QElapsedTimer sinceFlush;
+    sinceFlush.start();
+
+    for (;;) {
+        bool sawError = false;
+        int records = drain(batch, sawError);
+        pendingRecords += records;
+
+        bool requested;
+        {
+            QMutexLocker locker(&wakeMutex);
+            requested = flushRequested;
+        }
+        bool stop = stopping;
+
+        bool due = sawError || requested || stop
+            || (policy.everyLines > 0 && batch.size() >= policy.everyLines)
+            || sinceFlush.elapsed() >= policy.intervalMs;
+        if (due) {
+            if (!batch.isEmpty()) {
+                writeBatch(batch, sawError && policy.syncOnError);
+            }
+            doneRecords += pendingRecords;
+            pendingRecords = 0;
+            sinceFlush.restart();
+        }
+
+        QMutexLocker locker(&wakeMutex);
+        writtenCount = doneRecords;
+        if (pendingRecords == 0 && ring.isEmpty()) {
+            flushRequested = false;
+        }
+        written.wakeAll();
+
+        if (stop && pendingRecords == 0 && ring.isEmpty()) {
+            break;
+        }
+        if (records < kMaxBatch && !flushRequested && !stopping) {
+            wakeup.wait(&wakeMutex, kPollMs);
+        }
+    }
+}
+
+int Logger::drain(QList<LogEntry> &batch, bool &sawError) {
+    quint64 dropped = droppedCount.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        Record notice;
+        notice.timestamp = QDateTime::currentMSecsSinceEpoch();
+        notice.level = LogLevel::Warning;
+        notice.message = QString("日志缓冲区已满，丢弃了 %1 条日志").arg(dropped);
+        appendEntry(notice, batch);
+    }
+
+    int records = 0;
+    Record record;
+    while (records < kMaxBatch && ring.pop(record)) {
+        ++records;
+        switch (record.kind) {
+        case Record::SessionStart:
+            contextSession = record.message;
+            contextPackage = record.package;
+            contextStage.clear();
+            break;
+        case Record::StageChange:
+            contextStage = record.message;
+            break;
+        default:
+            if (record.level == LogLevel::Error) {
+                sawError = true;
+            }
+            appendEntry(record, batch);
+            break;
+        }
+    }
+    return records;
+}
+
+void Logger::appendEntry(const Record &record, QList<LogEntry> &batch) {
+    LogEntry entry;
+    entry.timestamp = record.timestamp;
+    entry.level = record.level;
+    entry.session = contextSession;
+    entry.package = contextPackage;
+    entry.stage = contextStage;
+    entry.message = record.message;
+    batch.append(entry);
+}
+
+void Logger::format(const LogEntry &entry, QByteArray &buffer) {
+    qint64 second = entry.timestamp / 1000;
+    if (second != stampSecond) {
+        stampSecond = second;
+        stampText = QDateTime::fromMSecsSinceEpoch(entry.timestamp)
+            .toString("yyyy-MM-dd hh:mm:ss").toUtf8();
+    }
+
+    buffer.append('[');
+    buffer.append(stampText);
+    buffer.append("] [");
+    buffer.append(levelToString(entry.level).toLatin1());
+    buffer.append("] ");
+    buffer.append(entry.message.toUtf8());
+    buffer.append('\n');
+}
+
+void Logger::writeBatch(QList<LogEntry> &batch, bool sync) {
+    {
+        QMutexLocker locker(&fileMutex);
+        store.append(batch);
+        if (sync) {
+            store.sync();
+        }
+    }
+
+    // Also print to console
+    if (policy.console) {
+        QByteArray buffer;
+        for (const LogEntry &entry : batch) {
+            format(entry, buffer);
+        }
+        std::cout.write(buffer.constData(), buffer.size());
+        std::cout.flush();
     }
+    batch.clear();
 }
@@ -1,19 +1,33 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include "mpscring.h"
+#include "logstore.h"
+
 #include <QString>
-#include <QFile>
-#include <QTextStream>
 #include <QDateTime>
 #include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+
+class QThread;
 
-enum class LogLevel {
-    Debug,
-    Info,
-    Warning,
-    Error
+// When the writer thread pushes buffered lines to disk
+struct LogFlushPolicy {
+    int everyLines = 64;        // flush after this many lines (0 = never by count)
+    int intervalMs = 200;       // flush at least this often while lines are pending
+    bool syncOnError = true;    // fsync as soon as an Error line is written
+    bool console = true;        // also print to stdout
+    qint64 maxFileSize = 10 * 1024 * 1024;  // rotate the log past this size
+    int maxFiles = 5;           // generations kept, current one included
 };
 
+// Logging calls only stamp the record and push it into a lock-free ring;
+// a dedicated writer thread tags the records with the current session
+// and stage and appends them in batches to a LogStore according to the
+// flush policy. When the ring is full, records are dropped and counted
+// rather than blocking the caller.
 class Logger {
 public:
     Logger();
@@ -24,16 +38,78 @@ public:
     void warning(const QString &message);
     void error(const QString &message);
 
+    // Start a new session for a bundle; later records carry its id
+    QString beginSession(const QString &package);
+
+    // Tag later records with a pipeline stage
+    void setStage(const QString &stage);
+
+    // Id of the current session, empty before the first one
+    QString currentSession() const;
+
+    // Wait until everything logged so far is written to the file
+    void flush();
+
+    // Paged, filtered records; see LogStore::query()
+    LogPage query(const LogQuery &query);
+
     QString getLogFilePath() const;
-    QString getAllLogs() const;
     void clearLogs();
 
 private:
+    struct Record {
+        enum Kind {
+            Message,
+            SessionStart,   // message is the session id
+            StageChange     // message is the stage
+        };
+
+        Kind kind = Message;
+        qint64 timestamp = 0;
+        LogLevel level = LogLevel::Info;
+        QString message;
+        QString package;
+    };
+
     void log(LogLevel level, const QString &message);
+    void pushContext(Record record);
     QString levelToString(LogLevel level) const;
+    void writerLoop();
+    int drain(QList<LogEntry> &batch, bool &sawError);
+    void appendEntry(const Record &record, QList<LogEntry> &batch);
+    void format(const LogEntry &entry, QByteArray &buffer);
+    void writeBatch(QList<LogEntry> &batch, bool sync);
+
+    LogFlushPolicy policy;
+    MpscRing<Record> ring;
+    std::atomic<quint64> pushedCount;
+    std::atomic<quint64> droppedCount;
+    std::atomic<bool> stopping;
+
+    // The writer sleeps on wakeup between batches; flush() waits on written
+    QMutex wakeMutex;
+    QWaitCondition wakeup;
+    QWaitCondition written;
+    quint64 writtenCount;
+    bool flushRequested;
+
+    // Held by the writer while it touches the store
+    QMutex fileMutex;
+    LogStore store;
+
+    // Writer-side context applied to message records
+    QString contextSession;
+    QString contextPackage;
+    QString contextStage;
+
+    mutable QMutex sessionMutex;
+    QString sessionId;
+
+    // Writer-side timestamp cache, one conversion per second
+    qint64 stampSecond;
+    QByteArray stampText;
 
-    QFile logFile;
-    QMutex mutex;
+    std::unique_ptr<QThread> writer;
 };
 
 #endif // LOGGER_H
@@ -0,0 +1,360 @@
+#include "logstore.h"
+
+#include <QDir>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QVector>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+// Sidecar index entry; host byte order, the files never leave the machine
+struct IndexEntry {
+    quint64 offset;
+    quint32 session;
+    quint32 level;
+};
+static_assert(sizeof(IndexEntry) == 16, "index entries are 16 bytes");
+
+const qint64 kEntrySize = sizeof(IndexEntry);
+
+quint32 sessionHash(const QString &session) {
+    return qHash(session);
+}
+
+void appendIndexEntry(QByteArray &out, quint64 offset, const LogEntry &entry) {
+    IndexEntry index;
+    index.offset = offset;
+    index.session = sessionHash(entry.session);
+    index.level = static_cast<quint32>(entry.level);
+    out.append(reinterpret_cast<const char *>(&index), sizeof(index));
+}
+
+void appendString(QByteArray &out, const QString &value) {
+    static const char hex[] = "0123456789abcdef";
+
+    out.append('"');
+    const QByteArray utf8 = value.toUtf8();
+    for (char c : utf8) {
+        switch (c) {
+        case '"':
+            out.append("\\\"");
+            break;
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '\n':
+            out.append("\\n");
+            break;
+        case '\r':
+            out.append("\\r");
+            break;
+        case '\t':
+            out.append("\\t");
+            break;
+        default:
+            if (static_cast<uchar>(c) < 0x20) {
+                out.append("\\u00");
+                out.append(hex[(c >> 4) & 0xf]);
+                out.append(hex[c & 0xf]);
+            } else {
+                out.append(c);
+            }
+        }
+    }
+    out.append('"');
+}
+
+void appendLine(QByteArray &out, const LogEntry &entry) {
+    out.append("{\"ts\":");
+    out.append(QByteArray::number(entry.timestamp));
+    out.append(",\"level\":");
+    appendString(out, LogStore::levelName(entry.level));
+    out.append(",\"session\":");
+    appendString(out, entry.session);
+    out.append(",\"package\":");
+    appendString(out, entry.package);
+    out.append(",\"stage\":");
+    appendString(out, entry.stage);
+    out.append(",\"msg\":");
+    appendString(out, entry.message);
+    out.append("}\n");
+}
+
+bool parseLine(const QByteArray &line, LogEntry &entry) {
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        return false;
+    }
+
+    QJsonObject object = doc.object();
+    entry.timestamp = static_cast<qint64>(object.value("ts").toDouble());
+    entry.level = LogStore::levelFromName(object.value("level").toString());
+    entry.session = object.value("session").toString();
+    entry.package = object.value("package").toString();
+    entry.stage = object.value("stage").toString();
+    entry.message = object.value("msg").toString();
+    return true;
+}
+
+IndexEntry readIndexEntry(const QByteArray &raw, int i) {
+    IndexEntry entry;
+    memcpy(&entry, raw.constData() + i * kEntrySize, sizeof(entry));
+    return entry;
+}
+
+} // namespace
+
+LogStore::LogStore(const QString &directory, const QString &baseName, qint64 maxFileSize, int maxFiles)
+    : directory(directory)
+    , baseName(baseName)
+    , maxFileSize(maxFileSize)
+    , maxFiles(qMax(1, maxFiles))
+    , dataSize(0)
+{
+}
+
+LogStore::~LogStore() {
+    dataFile.close();
+    indexFile.close();
+}
+
+bool LogStore::open() {
+    QDir().mkpath(directory);
+
+    dataFile.setFileName(dataPath(0));
+    indexFile.setFileName(indexPath(0));
+    if (!dataFile.open(QIODevice::ReadWrite | QIODevice::Append)
+        || !indexFile.open(QIODevice::ReadWrite | QIODevice::Append)) {
+        dataFile.close();
+        indexFile.close();
+        return false;
+    }
+
+    dataSize = dataFile.size();
+    return recoverIndex();
+}
+
+bool LogStore::append(const QList<LogEntry> &entries) {
+    if (!dataFile.isOpen() || entries.isEmpty()) {
+        return false;
+    }
+
+    QByteArray data;
+    QByteArray index;
+    index.reserve(entries.size() * kEntrySize);
+
+    quint64 offset = static_cast<quint64>(dataSize);
+    for (const LogEntry &entry : entries) {
+        appendIndexEntry(index, offset + data.size(), entry);
+        appendLine(data, entry);
+    }
+
+    // Data before index, so every indexed offset is backed by a full line
+    bool ok = dataFile.write(data) == data.size();
+    dataFile.flush();
+    ok = ok && indexFile.write(index) == index.size();
+    indexFile.flush();
+    dataSize += data.size();
+
+    if (dataSize >= maxFileSize) {
+        rotate();
+    }
+    return ok;
+}
+
+void LogStore::sync() {
+    if (dataFile.isOpen()) {
+        ::fsync(dataFile.handle());
+        ::fsync(indexFile.handle());
+    }
+}
+
+LogPage LogStore::query(const LogQuery &query) const {
+    struct Hit {
+        int generation;
+        quint64 offset;
+    };
+
+    // Filter on the index alone
+    QVector<Hit> hits;
+    quint32 wanted = sessionHash(query.session);
+    for (int generation = maxFiles - 1; generation >= 0; --generation) {
+        QFile index(indexPath(generation));
+        if (!index.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        QByteArray raw = index.readAll();
+        int count = static_cast<int>(raw.size() / kEntrySize);
+        for (int i = 0; i < count; ++i) {
+            IndexEntry entry = readIndexEntry(raw, i);
+            if (entry.level < static_cast<quint32>(query.minLevel)) {
+                continue;
+            }
+            if (!query.session.isEmpty() && entry.session != wanted) {
+                continue;
+            }
+            hits.append(Hit{generation, entry.offset});
+        }
+    }
+
+    LogPage page;
+    page.total = hits.size();
+
+    int start = query.offset < 0 ? qMax(0, hits.size() + query.offset) : query.offset;
+    int end = qMin(hits.size(), start + qMax(0, query.limit));
+
+    // Read only the lines of the page
+    QFile data;
+    int openGeneration = -1;
+    for (int i = start; i < end; ++i) {
+        const Hit &hit = hits[i];
+        if (hit.generation != openGeneration) {
+            data.close();
+            data.setFileName(dataPath(hit.generation));
+            if (!data.open(QIODevice::ReadOnly)) {
+                openGeneration = -1;
+                continue;
+            }
+            openGeneration = hit.generation;
+        }
+
+        LogEntry entry;
+        if (!data.seek(static_cast<qint64>(hit.offset)) || !parseLine(data.readLine(), entry)) {
+            continue;
+        }
+        // A hash match is confirmed against the stored session
+        if (!query.session.isEmpty() && entry.session != query.session) {
+            continue;
+        }
+        page.entries.append(entry);
+    }
+
+    return page;
+}
+
+void LogStore::clear() {
+    dataFile.close();
+    indexFile.close();
+    for (int generation = 0; generation < maxFiles; ++generation) {
+        QFile::remove(dataPath(generation));
+        QFile::remove(indexPath(generation));
+    }
+    open();
+}
+
+QString LogStore::filePath() const {
+    return dataPath(0);
+}
+
+QString LogStore::levelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::Debug:
+        return "DEBUG";
+    case LogLevel::Info:
+        return "INFO";
+    case LogLevel::Warning:
+        return "WARNING";
+    case LogLevel::Error:
+        return "ERROR";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+LogLevel LogStore::levelFromName(const QString &name) {
+    if (name == "DEBUG") {
+        return LogLevel::Debug;
+    }
+    if (name == "WARNING") {
+        return LogLevel::Warning;
+    }
+    if (name == "ERROR") {
+        return LogLevel::Error;
+    }
+    return LogLevel::Info;
+}
+
+QString LogStore::dataPath(int generation) const {
+    if (generation == 0) {
+        return QString("%1/%2.jsonl").arg(directory, baseName);
+    }
+    return QString("%1/%2.%3.jsonl").arg(directory, baseName).arg(generation);
+}
+
+QString LogStore::indexPath(int generation) const {
+    return dataPath(generation) + ".idx";
+}
+
+bool LogStore::recoverIndex() {
+    QFile reader(dataFile.fileName());
+    if (!reader.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // Drop index entries that do not point at a complete line
+    qint64 indexSize = indexFile.size() - indexFile.size() % kEntrySize;
+    qint64 resumeAt = 0;
+    while (indexSize > 0) {
+        indexFile.seek(indexSize - kEntrySize);
+        QByteArray raw = indexFile.read(kEntrySize);
+        IndexEntry last = readIndexEntry(raw, 0);
+        if (static_cast<qint64>(last.offset) < dataSize && reader.seek(static_cast<qint64>(last.offset))) {
+            QByteArray line = reader.readLine();
+            if (line.endsWith('\n')) {
+                resumeAt = static_cast<qint64>(last.offset) + line.size();
+                break;
+            }
+        }
+        indexSize -= kEntrySize;
+    }
+    if (indexSize != indexFile.size()) {
+        indexFile.resize(indexSize);
+    }
+
+    // Index complete lines written after the last indexed one; a torn
+    // final line is cut off
+    QByteArray index;
+    qint64 pos = resumeAt;
+    reader.seek(pos);
+    while (!reader.atEnd()) {
+        QByteArray line = reader.readLine();
+        if (!line.endsWith('\n')) {
+            break;
+        }
+        LogEntry entry;
+        if (parseLine(line, entry)) {
+            appendIndexEntry(index, static_cast<quint64>(pos), entry);
+        }
+        pos += line.size();
+    }
+    reader.close();
+
+    if (pos < dataSize) {
+        dataFile.resize(pos);
+        dataSize = pos;
+    }
+    if (!index.isEmpty()) {
+        indexFile.write(index);
+        indexFile.flush();
+    }
+    return true;
+}
+
+void LogStore::rotate() {
+    dataFile.close();
+    indexFile.close();
+
+    QFile::remove(dataPath(maxFiles - 1));
+    QFile::remove(indexPath(maxFiles - 1));
+    for (int generation = maxFiles - 2; generation >= 0; --generation) {
+        QFile::rename(dataPath(generation), dataPath(generation + 1));
+        QFile::rename(indexPath(generation), indexPath(generation + 1));
+    }
+
+    open();
+}
@@ -0,0 +1,86 @@
+#ifndef LOGSTORE_H
+#define LOGSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QFile>
+
+enum class LogLevel {
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+// One structured log record
+struct LogEntry {
+    qint64 timestamp = 0;       // ms since epoch
+    LogLevel level = LogLevel::Info;
+    QString session;            // install session the record belongs to
+    QString package;            // bundle the session works on
+    QString stage;              // pipeline stage at the time
+    QString message;
+};
+
+// Filter and page for LogStore::query()
+struct LogQuery {
+    QString session;                    // empty = every session
+    LogLevel minLevel = LogLevel::Debug;
+    int offset = 0;                     // first matching record; negative counts from the end
+    int limit = 1000;
+};
+
+struct LogPage {
+    QList<LogEntry> entries;
+    int total = 0;                      // matching records over all files
+};
+
+// Append-only JSONL log (one JSON object per line) with a sidecar index
+// of fixed 16-byte entries: line offset, session hash and level. Queries
+// filter on the index alone and read only the lines of the requested
+// page. Files rotate by size, keeping a fixed number of old generations.
+//
+// Not thread-safe; the owner serializes calls.
+class LogStore {
+public:
+    LogStore(const QString &directory, const QString &baseName, qint64 maxFileSize, int maxFiles);
+    ~LogStore();
+
+    // Open the current file, re-indexing lines a crash left unindexed
+    bool open();
+
+    // Append records and rotate if the file grew past the limit
+    bool append(const QList<LogEntry> &entries);
+
+    // Push written data to the disk
+    void sync();
+
+    // Matching records, oldest first, from all generations
+    LogPage query(const LogQuery &query) const;
+
+    // Delete every generation and start empty
+    void clear();
+
+    // Path of the current data file
+    QString filePath() const;
+
+    static QString levelName(LogLevel level);
+    static LogLevel levelFromName(const QString &name);
+
+private:
+    QString dataPath(int generation) const;
+    QString indexPath(int generation) const;
+    bool recoverIndex();
+    void rotate();
+
+    QString directory;
+    QString baseName;
+    qint64 maxFileSize;
+    int maxFiles;
+    QFile dataFile;
+    QFile indexFile;
+    qint64 dataSize;
+};
+
+#endif // LOGSTORE_H
@@ -0,0 +1,99 @@
+#include "logviewmodel.h"
+
+#include <QTimer>
+
+namespace {
+
+// One frame at 60 Hz
+const int kFlushIntervalMs = 16;
+
+} // namespace
+
+LogViewModel::LogViewModel(int capacity, QObject *parent)
+    : QAbstractListModel(parent)
+    , ring(qMax(1, capacity))
+    , head(0)
+    , count(0)
+    , flushTimer(new QTimer(this))
+{
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(kFlushIntervalMs);
+    connect(flushTimer, &QTimer::timeout, this, &LogViewModel::flush);
+}
+
+int LogViewModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : count;
+}
+
+QVariant LogViewModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= count || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    return lineAt(index.row());
+}
+
+void LogViewModel::appendText(const QString &text) {
+    QStringList parts = text.split('\n');
+    // A trailing '\n' ends the last line rather than starting an empty one
+    if (parts.size() > 1 && parts.last().isEmpty()) {
+        parts.removeLast();
+    }
+    pending.append(parts);
+
+    // Keep at most a ring's worth waiting
+    if (pending.size() > ring.size()) {
+        pending.erase(pending.begin(), pending.end() - ring.size());
+    }
+
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
+}
+
+void LogViewModel::clear() {
+    flushTimer->stop();
+    pending.clear();
+
+    beginResetModel();
+    for (int row = 0; row < count; ++row) {
+        ring[(head + row) % ring.size()].clear();
+    }
+    head = 0;
+    count = 0;
+    endResetModel();
+}
+
+void LogViewModel::flush() {
+    flushTimer->stop();
+    if (pending.isEmpty()) {
+        return;
+    }
+
+    const int capacity = ring.size();
+    const int incoming = pending.size();
+
+    // Make room by dropping the oldest lines in one removal
+    int overflow = count + incoming - capacity;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        for (int row = 0; row < overflow; ++row) {
+            ring[(head + row) % capacity].clear();
+        }
+        head = (head + overflow) % capacity;
+        count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), count, count + incoming - 1);
+    for (const QString &line : pending) {
+        ring[(head + count) % capacity] = line;
+        ++count;
+    }
+    endInsertRows();
+
+    pending.clear();
+}
+
+const QString &LogViewModel::lineAt(int row) const {
+    return ring[(head + row) % ring.size()];
+}
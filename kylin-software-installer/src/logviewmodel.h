@@ -0,0 +1,43 @@
+#ifndef LOGVIEWMODEL_H
+#define LOGVIEWMODEL_H
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QVector>
+
+class QTimer;
+
+// List model of log lines for a virtualized view. Lines live in a ring
+// buffer of fixed capacity, so the oldest ones fall out once it is full.
+// Appends are coalesced and reach the view in one batch at most every
+// frame (~16 ms), however fast the package manager writes.
+class LogViewModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    explicit LogViewModel(int capacity, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    // Queue text for display; each '\n' ends a line
+    void appendText(const QString &text);
+
+    // Drop all lines, shown and pending
+    void clear();
+
+public slots:
+    // Move pending lines into the model now
+    void flush();
+
+private:
+    const QString &lineAt(int row) const;
+
+    QVector<QString> ring;
+    int head;
+    int count;
+    QStringList pending;
+    QTimer *flushTimer;
+};
+
+#endif // LOGVIEWMODEL_H
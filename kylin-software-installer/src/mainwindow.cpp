@@ -5,16 +5,21 @@
 #include "installscreen.h"
 #include "completescreen.h"
 #include "logger.h"
+#include "packagesession.h"
 
 #include <QVBoxLayout>
 #include <QApplication>
 #include <QSettings>
 #include <QScreen>
 #include <QCloseEvent>
+#include <QFileInfo>
+#include <QMessageBox>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , logger(std::make_shared<Logger>())
+    , session(std::make_shared<PackageSession>(logger))
+    , closePending(false)
 {
     setWindowTitle("银河麒麟软件安装助手");
     setWindowIcon(QIcon(":/icons/app.png"));
@@ -44,9 +49,9 @@ void MainWindow::initializeUI() {
     
     // Create screens
     welcomeScreen = std::make_unique<WelcomeScreen>(logger, this);
-    packageInfoScreen = std::make_unique<PackageInfoScreen>(logger, this);
-    dependencyScreen = std::make_unique<DependencyScreen>(logger, this);
-    installScreen = std::make_unique<InstallScreen>(logger, this);
+    packageInfoScreen = std::make_unique<PackageInfoScreen>(logger, session, this);
+    dependencyScreen = std::make_unique<DependencyScreen>(logger, session, this);
+    installScreen = std::make_unique<InstallScreen>(logger, session, this);
     completeScreen = std::make_unique<CompleteScreen>(logger, this);
     
     // Add screens to stacked widget
@@ -74,7 +79,7 @@ void MainWindow::setupConnections() {
     
     // Dependency screen signals
     connect(dependencyScreen.get(), &DependencyScreen::installConfirmed,
-            this, &MainWindow::onInstallConfirmed);
+            this, &MainWindow::onInstallStarted);
     connect(dependencyScreen.get(), &DependencyScreen::backClicked,
             packageInfoScreen.get(), [this]() { stackedWidget->setCurrentWidget(packageInfoScreen.get()); });
     
@@ -93,6 +98,8 @@ void MainWindow::setupConnections() {
 
 void MainWindow::onPackageSelected(const QString &packagePath) {
     currentPackagePath = packagePath;
+    // Everything logged from here on belongs to this bundle's session
+    logger->beginSession(QFileInfo(packagePath).fileName());
     packageInfoScreen->loadPackage(packagePath);
     stackedWidget->setCurrentWidget(packageInfoScreen.get());
     logger->info(QString("选择软件包: %1").arg(packagePath));
@@ -104,9 +111,20 @@ void MainWindow::onInstallConfirmed() {
     stackedWidget->setCurrentWidget(dependencyScreen.get());
 }
 
+void MainWindow::onInstallStarted() {
+    // Move to install screen
+    stackedWidget->setCurrentWidget(installScreen.get());
+    installScreen->startInstall(currentPackagePath);
+}
+
 void MainWindow::onInstallCompleted(bool success) {
     completeScreen->setInstallResult(success, currentPackagePath);
     stackedWidget->setCurrentWidget(completeScreen.get());
+
+    // A close was deferred until the install stopped
+    if (closePending) {
+        close();
+    }
 }
 
 void MainWindow::onScreenChanged(int index) {
@@ -144,6 +162,21 @@ void MainWindow::saveWindowState() {
 }
 
 void MainWindow::closeEvent(QCloseEvent *event) {
+    // Closing mid-install would kill the package manager mid-transaction,
+    // so cancel what is still cancellable and close once the worker stops
+    if (installScreen->isRunning()) {
+        if (!closePending) {
+            QMessageBox::StandardButton answer = QMessageBox::question(
+                this, "安装进行中", "安装仍在进行。是否取消剩余的安装，并在当前步骤完成后退出？");
+            if (answer == QMessageBox::Yes) {
+                closePending = true;
+                installScreen->cancel();
+            }
+        }
+        event->ignore();
+        return;
+    }
+
     saveWindowState();
     event->accept();
 }
@@ -11,6 +11,7 @@ class DependencyScreen;
 class InstallScreen;
 class CompleteScreen;
 class Logger;
+class PackageSession;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -25,6 +26,7 @@ protected:
 private slots:
     void onPackageSelected(const QString &packagePath);
     void onInstallConfirmed();
+    void onInstallStarted();
     void onInstallCompleted(bool success);
     void onScreenChanged(int index);
 
@@ -41,8 +43,10 @@ private:
     std::unique_ptr<InstallScreen> installScreen;
     std::unique_ptr<CompleteScreen> completeScreen;
     std::shared_ptr<Logger> logger;
+    std::shared_ptr<PackageSession> session;
 
     QString currentPackagePath;
+    bool closePending;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,400 @@
+#include "manifestsidecar.h"
+#include "logger.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <climits>
+#include <cstring>
+
+// Sidecar layout, host byte order (the files never leave the machine):
+//
+//   Header                      fixed size, see below
+//   sections                    each 8-byte aligned, located by the header:
+//     arena                     UTF-8 text of every pooled string
+//     offsets     u32[n + 1]    string i is arena[offsets[i], offsets[i + 1])
+//     slots       u32[]         pool hash table, id + 1 per slot
+//     ids, names, versions,
+//     filenames, checksums      u32[packages], string ids
+//     sizes       i64[packages]
+//     dependency keys, starts, values and provides keys, starts, values:
+//                 one CSR list per relation map, all string ids
+
+namespace {
+
+const char kMagic[8] = {'K', 'Y', 'M', 'A', 'N', 'I', 'F', 'S'};
+const quint32 kFormatVersion = 1;
+const int kMaxSidecars = 32;
+const int kDigestSize = 32;
+
+enum Section {
+    Arena,
+    Offsets,
+    Slots,
+    Ids,
+    Names,
+    Versions,
+    Sizes,
+    Filenames,
+    Checksums,
+    DependencyKeys,
+    DependencyStarts,
+    DependencyValues,
+    ProvideKeys,
+    ProvideStarts,
+    ProvideValues,
+    SectionCount
+};
+
+struct Header {
+    char magic[8];
+    quint32 formatVersion;
+    quint32 headerSize;
+    quint8 metadataDigest[kDigestSize];
+    quint8 dependenciesDigest[kDigestSize];
+    quint64 fileSize;
+    quint32 stringCount;
+    quint32 slotCount;
+    quint32 packageCount;
+    quint32 dependencyCount;
+    quint32 provideCount;
+    quint32 version;                // string ids of the metadata fields
+    quint32 timestamp;
+    quint32 targetSystem;
+    quint32 targetArchitecture;
+    quint32 reserved;
+    qint64 totalSize;
+    quint64 sectionOffset[SectionCount];
+    quint64 sectionSize[SectionCount];
+};
+static_assert(sizeof(Header) % 8 == 0, "sections after the header stay aligned");
+
+// Relation map as CSR lists of string ids
+struct RelationColumns {
+    Column<quint32> keys;
+    Column<quint32> starts;
+    Column<quint32> values;
+};
+
+QByteArray digestBytes(const QString &hex) {
+    // No digest (no dependencies.json) is all zeros
+    QByteArray bytes = QByteArray::fromHex(hex.toLatin1()).left(kDigestSize);
+    bytes.append(QByteArray(kDigestSize - bytes.size(), '\0'));
+    return bytes;
+}
+
+RelationColumns internRelations(const QMap<QString, QStringList> &relations, StringPool &pool) {
+    RelationColumns columns;
+    columns.keys.reserve(relations.size());
+    columns.starts.reserve(relations.size() + 1);
+    columns.starts.append(0);
+    for (auto it = relations.constBegin(); it != relations.constEnd(); ++it) {
+        columns.keys.append(pool.intern(it.key()));
+        for (const QString &value : it.value()) {
+            columns.values.append(pool.intern(value));
+        }
+        columns.starts.append(static_cast<quint32>(columns.values.size()));
+    }
+    return columns;
+}
+
+// Whether every entry of a column is a string id below stringCount
+bool idsInRange(const Column<quint32> &column, quint32 stringCount) {
+    for (int i = 0; i < column.size(); ++i) {
+        if (column.at(i) >= stringCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether offsets start at 0, never decrease and end at the arena size
+bool offsetsValid(const Column<quint32> &offsets, quint64 arenaSize) {
+    if (offsets.isEmpty() || offsets.at(0) != 0 || offsets.at(offsets.size() - 1) != arenaSize) {
+        return false;
+    }
+    for (int i = 1; i < offsets.size(); ++i) {
+        if (offsets.at(i) < offsets.at(i - 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Rebuild a relation map from its mapped CSR lists
+bool readRelations(const Column<quint32> &keys, const Column<quint32> &starts,
+                   const Column<quint32> &values, const StringPool &pool,
+                   QMap<QString, QStringList> &relations) {
+    for (int i = 0; i < keys.size(); ++i) {
+        quint32 begin = starts.at(i);
+        quint32 end = starts.at(i + 1);
+        if (begin > end || end > static_cast<quint32>(values.size())) {
+            return false;
+        }
+        QStringList list;
+        list.reserve(static_cast<int>(end - begin));
+        for (quint32 j = begin; j < end; ++j) {
+            list.append(pool.value(values.at(static_cast<int>(j))));
+        }
+        relations.insert(pool.value(keys.at(i)), list);
+    }
+    return true;
+}
+
+} // namespace
+
+ManifestSidecar::ManifestSidecar(std::shared_ptr<Logger> logger)
+    : logger(logger)
+    , directory(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/manifests")
+{
+}
+
+bool ManifestSidecar::load(const ManifestDigests &digests, PackageMetadata &metadata,
+                           QMap<QString, QStringList> &dependencies,
+                           QMap<QString, QStringList> &provides) {
+    errorMessage.clear();
+
+    QString path = pathFor(digests);
+    auto file = std::make_shared<QFile>(path);
+    if (!file->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // A sidecar that fails any check is dropped, so the next open
+    // parses the JSON and writes a fresh one
+    auto reject = [this, &file, &path](const QString &message) {
+        errorMessage = message;
+        logger->warning(QString("%1，已删除: %2").arg(message, path));
+        file->close();
+        QFile::remove(path);
+        return false;
+    };
+
+    qint64 fileSize = file->size();
+    const uchar *base = fileSize >= static_cast<qint64>(sizeof(Header)) ? file->map(0, fileSize) : nullptr;
+    if (!base) {
+        return reject("清单缓存无法映射");
+    }
+
+    Header header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+            || header.formatVersion != kFormatVersion
+            || header.headerSize != sizeof(Header)
+            || header.fileSize != static_cast<quint64>(fileSize)) {
+        return reject("清单缓存版本不符");
+    }
+
+    // The digests of the source manifests are the validity check
+    if (std::memcmp(header.metadataDigest, digestBytes(digests.metadata).constData(), kDigestSize) != 0
+            || std::memcmp(header.dependenciesDigest, digestBytes(digests.dependencies).constData(), kDigestSize) != 0) {
+        return reject("清单缓存与软件包清单不符");
+    }
+
+    // Every section must lie inside the file, aligned and of the size its
+    // count implies; the arena and value lists are sized by themselves
+    const quint64 expected[SectionCount] = {
+        header.sectionSize[Arena],
+        (header.stringCount + 1ull) * 4,
+        header.slotCount * 4ull,
+        header.packageCount * 4ull,
+        header.packageCount * 4ull,
+        header.packageCount * 4ull,
+        header.packageCount * 8ull,
+        header.packageCount * 4ull,
+        header.packageCount * 4ull,
+        header.dependencyCount * 4ull,
+        (header.dependencyCount + 1ull) * 4,
+        header.sectionSize[DependencyValues] - header.sectionSize[DependencyValues] % 4,
+        header.provideCount * 4ull,
+        (header.provideCount + 1ull) * 4,
+        header.sectionSize[ProvideValues] - header.sectionSize[ProvideValues] % 4,
+    };
+    for (int section = 0; section < SectionCount; ++section) {
+        quint64 offset = header.sectionOffset[section];
+        quint64 size = header.sectionSize[section];
+        if (size != expected[section] || offset % 8 != 0 || offset < sizeof(Header)
+                || offset > header.fileSize || size > header.fileSize - offset || size > INT_MAX) {
+            return reject("清单缓存已损坏");
+        }
+    }
+    // Slots must form a power-of-two table with room to spare
+    if (header.slotCount <= header.stringCount || (header.slotCount & (header.slotCount - 1)) != 0) {
+        return reject("清单缓存已损坏");
+    }
+
+    auto at = [base, &header](int section) {
+        return reinterpret_cast<const char *>(base + header.sectionOffset[section]);
+    };
+    auto words = [&header, &at](int section) {
+        return Column<quint32>::fromRawData(at(section), static_cast<int>(header.sectionSize[section] / 4));
+    };
+
+    // Every offset and string id is checked before the pool reads through
+    // it, so a corrupted file cannot make it read outside the mapping
+    const quint32 stringCount = header.stringCount;
+    Column<quint32> offsets = words(Offsets);
+    Column<quint32> slots = words(Slots);
+    if (!offsetsValid(offsets, header.sectionSize[Arena])
+            || !idsInRange(slots, stringCount + 1)
+            || header.version >= stringCount || header.timestamp >= stringCount
+            || header.targetSystem >= stringCount || header.targetArchitecture >= stringCount) {
+        return reject("清单缓存已损坏");
+    }
+    const int idSections[] = {Ids, Names, Versions, Filenames, Checksums,
+                              DependencyKeys, DependencyValues, ProvideKeys, ProvideValues};
+    for (int section : idSections) {
+        if (!idsInRange(words(section), stringCount)) {
+            return reject("清单缓存已损坏");
+        }
+    }
+
+    // Point the table into the mapping; nothing is copied
+    PackageMetadata loaded;
+    StringPool &pool = loaded.packages.pool;
+    pool.arena = QByteArray::fromRawData(at(Arena), static_cast<int>(header.sectionSize[Arena]));
+    pool.offsets = offsets;
+    pool.slots = slots;
+    pool.mapping = file;
+
+    loaded.packages.ids = words(Ids);
+    loaded.packages.names = words(Names);
+    loaded.packages.versions = words(Versions);
+    loaded.packages.sizes = Column<qint64>::fromRawData(at(Sizes), static_cast<int>(header.packageCount));
+    loaded.packages.filenames = words(Filenames);
+    loaded.packages.checksums = words(Checksums);
+
+    loaded.version = pool.value(header.version);
+    loaded.timestamp = pool.value(header.timestamp);
+    loaded.targetSystem = pool.value(header.targetSystem);
+    loaded.targetArchitecture = pool.value(header.targetArchitecture);
+    loaded.totalSize = header.totalSize;
+
+    QMap<QString, QStringList> loadedDependencies;
+    QMap<QString, QStringList> loadedProvides;
+    if (!readRelations(words(DependencyKeys), words(DependencyStarts), words(DependencyValues),
+                       pool, loadedDependencies)
+            || !readRelations(words(ProvideKeys), words(ProvideStarts), words(ProvideValues),
+                              pool, loadedProvides)) {
+        return reject("清单缓存已损坏");
+    }
+
+    metadata = loaded;
+    dependencies = loadedDependencies;
+    provides = loadedProvides;
+
+    // Mark as recently used for prune()
+    file->setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+    logger->info(QString("使用清单缓存，包含 %1 个软件包").arg(metadata.packages.size()));
+    return true;
+}
+
+bool ManifestSidecar::store(const ManifestDigests &digests, const PackageMetadata &metadata,
+                            const QMap<QString, QStringList> &dependencies,
+                            const QMap<QString, QStringList> &provides) {
+    errorMessage.clear();
+    if (!QDir().mkpath(directory)) {
+        errorMessage = QString("无法创建清单缓存目录: %1").arg(directory);
+        logger->warning(errorMessage);
+        return false;
+    }
+
+    // Relations and metadata fields share the table's pool
+    StringPool pool = metadata.packages.strings();
+    RelationColumns dependencyColumns = internRelations(dependencies, pool);
+    RelationColumns provideColumns = internRelations(provides, pool);
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.formatVersion = kFormatVersion;
+    header.headerSize = sizeof(Header);
+    std::memcpy(header.metadataDigest, digestBytes(digests.metadata).constData(), kDigestSize);
+    std::memcpy(header.dependenciesDigest, digestBytes(digests.dependencies).constData(), kDigestSize);
+    header.version = pool.intern(metadata.version);
+    header.timestamp = pool.intern(metadata.timestamp);
+    header.targetSystem = pool.intern(metadata.targetSystem);
+    header.targetArchitecture = pool.intern(metadata.targetArchitecture);
+    header.totalSize = metadata.totalSize;
+    header.stringCount = static_cast<quint32>(pool.count());
+    header.slotCount = static_cast<quint32>(pool.slots.size());
+    header.packageCount = static_cast<quint32>(metadata.packages.size());
+    header.dependencyCount = static_cast<quint32>(dependencyColumns.keys.size());
+    header.provideCount = static_cast<quint32>(provideColumns.keys.size());
+
+    const PackageTable &table = metadata.packages;
+    const QByteArray *sections[SectionCount] = {
+        &pool.arena,
+        &pool.offsets.raw(),
+        &pool.slots.raw(),
+        &table.ids.raw(),
+        &table.names.raw(),
+        &table.versions.raw(),
+        &table.sizes.raw(),
+        &table.filenames.raw(),
+        &table.checksums.raw(),
+        &dependencyColumns.keys.raw(),
+        &dependencyColumns.starts.raw(),
+        &dependencyColumns.values.raw(),
+        &provideColumns.keys.raw(),
+        &provideColumns.starts.raw(),
+        &provideColumns.values.raw(),
+    };
+
+    quint64 offset = sizeof(Header);
+    for (int section = 0; section < SectionCount; ++section) {
+        header.sectionOffset[section] = offset;
+        header.sectionSize[section] = static_cast<quint64>(sections[section]->size());
+        offset = (offset + header.sectionSize[section] + 7) & ~quint64(7);
+    }
+    header.fileSize = offset;
+
+    // QSaveFile renames into place on commit, so a reader never maps a partial file
+    QSaveFile file(pathFor(digests));
+    if (!file.open(QIODevice::WriteOnly)) {
+        errorMessage = QString("无法写入清单缓存: %1").arg(file.fileName());
+        logger->warning(errorMessage);
+        return false;
+    }
+
+    static const char padding[8] = {};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (int section = 0; section < SectionCount; ++section) {
+        file.write(*sections[section]);
+        qint64 end = static_cast<qint64>(header.sectionOffset[section] + header.sectionSize[section]);
+        file.write(padding, static_cast<qint64>((8 - end % 8) % 8));
+    }
+    if (!file.commit()) {
+        errorMessage = QString("无法写入清单缓存: %1").arg(file.fileName());
+        logger->warning(errorMessage);
+        return false;
+    }
+
+    logger->debug(QString("已写入清单缓存: %1 (%2 KB)").arg(file.fileName()).arg(header.fileSize / 1024));
+    prune();
+    return true;
+}
+
+QString ManifestSidecar::getErrorMessage() const {
+    return errorMessage;
+}
+
+QString ManifestSidecar::pathFor(const ManifestDigests &digests) const {
+    QByteArray key = QCryptographicHash::hash((digests.metadata + ":" + digests.dependencies).toLatin1(),
+                                              QCryptographicHash::Sha256).toHex();
+    return directory + "/" + QString::fromLatin1(key) + ".kmf";
+}
+
+void ManifestSidecar::prune() {
+    // Keep the most recently used sidecars only
+    QDir dir(directory);
+    QFileInfoList files = dir.entryInfoList(QStringList() << "*.kmf", QDir::Files, QDir::Time);
+    for (int i = kMaxSidecars; i < files.size(); ++i) {
+        QFile::remove(files.at(i).absoluteFilePath());
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef MANIFESTSIDECAR_H
+#define MANIFESTSIDECAR_H
+
+#include "packageparser.h"
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <memory>
+
+class Logger;
+
+// SHA-256 of the manifests a sidecar is derived from, lowercase hex;
+// dependencies is empty for bundles without dependencies.json
+struct ManifestDigests {
+    QString metadata;
+    QString dependencies;
+};
+
+// Binary form of a bundle's parsed manifests: the package table, its
+// string pool and the dependency and provides relations, interned in the
+// same pool. Sidecars live under AppData/manifests, named after the
+// manifest digests, and carry those digests in their header.
+//
+// The layout is flat and offset-based (see manifestsidecar.cpp), so
+// loading maps the file, checks the header and points the package table
+// straight into the mapping. Only the relation maps are built, since the
+// dependency analyzer consumes them as QMaps.
+class ManifestSidecar {
+public:
+    explicit ManifestSidecar(std::shared_ptr<Logger> logger);
+
+    // Map the sidecar of these manifests; false if it is missing or stale
+    bool load(const ManifestDigests &digests, PackageMetadata &metadata,
+              QMap<QString, QStringList> &dependencies,
+              QMap<QString, QStringList> &provides);
+
+    // Write the sidecar of freshly parsed manifests, then drop old ones
+    bool store(const ManifestDigests &digests, const PackageMetadata &metadata,
+               const QMap<QString, QStringList> &dependencies,
+               const QMap<QString, QStringList> &provides);
+
+    // Get error message
+    QString getErrorMessage() const;
+
+private:
+    QString pathFor(const ManifestDigests &digests) const;
+    void prune();
+
+    std::shared_ptr<Logger> logger;
+    QString directory;
+    QString errorMessage;
+};
+
+#endif // MANIFESTSIDECAR_H
@@ -0,0 +1,92 @@
+#ifndef MPSCRING_H
+#define MPSCRING_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free queue for many producers and one consumer. Each slot
+// carries a sequence number that tells producers and the consumer whose
+// turn it is, so pushing is one CAS on the write position plus a store.
+// A full ring rejects the item instead of blocking the producer.
+template <typename T>
+class MpscRing {
+public:
+    // capacity is rounded up to a power of two
+    explicit MpscRing(int capacity)
+        : mask(roundUp(capacity) - 1)
+        , slots(new Slot[mask + 1])
+        , writePos(0)
+        , readPos(0)
+    {
+        for (quint64 i = 0; i <= mask; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Any thread; returns false if the ring is full
+    bool push(T item) {
+        quint64 pos = writePos.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;) {
+            slot = &slots[pos & mask];
+            quint64 sequence = slot->sequence.load(std::memory_order_acquire);
+            qint64 diff = static_cast<qint64>(sequence - pos);
+            if (diff == 0) {
+                if (writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = writePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = std::move(item);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only; returns false if nothing is ready
+    bool pop(T &item) {
+        Slot &slot = slots[readPos & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != readPos + 1) {
+            return false;
+        }
+
+        item = std::move(slot.value);
+        slot.value = T();
+        slot.sequence.store(readPos + mask + 1, std::memory_order_release);
+        ++readPos;
+        return true;
+    }
+
+    // Consumer thread only
+    bool isEmpty() const {
+        return slots[readPos & mask].sequence.load(std::memory_order_acquire) != readPos + 1;
+    }
+
+private:
+    struct Slot {
+        std::atomic<quint64> sequence;
+        T value;
+    };
+
+    static quint64 roundUp(int capacity) {
+        quint64 size = 2;
+        while (size < static_cast<quint64>(capacity)) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    const quint64 mask;
+    std::unique_ptr<Slot[]> slots;
+    // Separate cache lines: producers contend on writePos only
+    alignas(64) std::atomic<quint64> writePos;
+    alignas(64) quint64 readPos;
+};
+
+#endif // MPSCRING_H
@@ -1,5 +1,5 @@
 #include "packageinfoscreen.h"
-#include "packageparser.h"
+#include "packagesession.h"
 #include "logger.h"
 
 #include <QVBoxLayout>
@@ -10,9 +10,12 @@
 #include <QListWidgetItem>
 #include <QFont>
 
-PackageInfoScreen::PackageInfoScreen(std::shared_ptr<Logger> logger, QWidget *parent)
+PackageInfoScreen::PackageInfoScreen(std::shared_ptr<Logger> logger,
+                                     std::shared_ptr<PackageSession> session,
+                                     QWidget *parent)
     : QWidget(parent)
     , logger(logger)
+    , session(session)
 {
     initializeUI();
 }
@@ -20,11 +23,10 @@ PackageInfoScreen::PackageInfoScreen(std::shared_ptr<Logger> logger, QWidget *pa
 void PackageInfoScreen::loadPackage(const QString &packagePath) {
     currentPackagePath = packagePath;
 
-    PackageParser parser(logger);
-    if (parser.parsePackage(packagePath)) {
+    if (session->open(packagePath)) {
         displayPackageInfo();
     } else {
-        logger->error(QString("解析软件包失败: %1").arg(parser.getErrorMessage()));
+        logger->error(QString("解析软件包失败: %1").arg(session->getErrorMessage()));
     }
 }
 
@@ -108,12 +110,11 @@ void PackageInfoScreen::initializeUI() {
 }
 
 void PackageInfoScreen::displayPackageInfo() {
-    PackageParser parser(logger);
-    if (!parser.parsePackage(currentPackagePath)) {
+    if (!session->open(currentPackagePath)) {
         return;
     }
 
-    PackageMetadata metadata = parser.getMetadata();
+    PackageMetadata metadata = session->getMetadata();
 
     // Update labels
     packageNameLabel->setText(QString("软件包名称: %1").arg(metadata.version));
@@ -8,12 +8,15 @@ class QLabel;
 class QPushButton;
 class QListWidget;
 class Logger;
+class PackageSession;
 
 class PackageInfoScreen : public QWidget {
     Q_OBJECT
 
 public:
-    explicit PackageInfoScreen(std::shared_ptr<Logger> logger, QWidget *parent = nullptr);
+    explicit PackageInfoScreen(std::shared_ptr<Logger> logger,
+                               std::shared_ptr<PackageSession> session,
+                               QWidget *parent = nullptr);
 
     void loadPackage(const QString &packagePath);
 
@@ -30,6 +33,7 @@ private:
     void displayPackageInfo();
 
     std::shared_ptr<Logger> logger;
+    std::shared_ptr<PackageSession> session;
     QString currentPackagePath;
 
     QLabel *packageNameLabel;
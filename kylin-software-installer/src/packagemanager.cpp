@@ -1,45 +1,46 @@
 #include "packagemanager.h"
 #include "logger.h"
+#include "installedpackageindex.h"
+#include "processrunner.h"
+#include "systemcapabilities.h"
 
-#include <QProcess>
 #include <QFile>
 #include <QFileInfo>
+#include <QRegularExpression>
+
+namespace {
+
+// Per-command limits; large bundles can keep the package manager busy long
+const int kInstallTimeoutMs = 60 * 60 * 1000;
+const int kRemoveTimeoutMs = 30 * 60 * 1000;
+const int kUpdateTimeoutMs = 10 * 60 * 1000;
+
+} // namespace
 
 PackageManager::PackageManager(std::shared_ptr<Logger> logger)
     : logger(logger)
-    , currentPackageManager(PackageManagerType::Unknown)
+    , installedIndex(InstalledPackageIndex::instance(logger))
+    , capabilities(SystemCapabilities::instance(logger))
+    , currentPackageManager(capabilities->packageManager())
+    , cancelFlag(nullptr)
 {
-    currentPackageManager = detectPackageManager();
 }
 
 PackageManagerType PackageManager::detectPackageManager() {
-    logger->info("检测系统包管理器");
-    
-    // Check for apt (Debian/Ubuntu)
-    QProcess process;
-    process.start("which", QStringList() << "apt");
-    if (process.waitForFinished() && process.exitCode() == 0) {
-        logger->info("检测到 APT 包管理器");
-        return PackageManagerType::APT;
-    }
-    
-    // Check for yum (RedHat/CentOS)
-    process.start("which", QStringList() << "yum");
-    if (process.waitForFinished() && process.exitCode() == 0) {
-        logger->info("检测到 YUM 包管理器");
-        return PackageManagerType::YUM;
-    }
-    
-    // Check for dnf (Fedora)
-    process.start("which", QStringList() << "dnf");
-    if (process.waitForFinished() && process.exitCode() == 0) {
-        logger->info("检测到 DNF 包管理器");
-        return PackageManagerType::DNF;
+    currentPackageManager = capabilities->packageManager();
+    if (currentPackageManager == PackageManagerType::Unknown) {
+        errorMessage = "无法检测到支持的包管理器";
+        logger->error(errorMessage);
     }
-    
-    errorMessage = "无法检测到支持的包管理器";
-    logger->error(errorMessage);
-    return PackageManagerType::Unknown;
+    return currentPackageManager;
+}
+
+void PackageManager::setCancelFlag(const std::atomic<bool> *flag) {
+    cancelFlag = flag;
+}
+
+void PackageManager::setOutputHandler(const OutputHandler &handler) {
+    outputHandler = handler;
 }
 
 bool PackageManager::installPackage(const QString &packagePath) {
@@ -55,6 +56,10 @@ bool PackageManager::installPackages(const QStringList &packagePaths) {
     
     logger->info(QString("开始安装 %1 个软件包").arg(packagePaths.size()));
     
+    if (!checkLocalInstall(packagePaths)) {
+        return false;
+    }
+    
     QString command;
     QStringList arguments;
     
@@ -77,29 +82,81 @@ bool PackageManager::installPackages(const QStringList &packagePaths) {
         return false;
     }
     
-    return executeCommand(command, arguments);
+    return executeCommand(command, arguments, kInstallTimeoutMs, false);
 }
 
-bool PackageManager::isPackageInstalled(const QString &packageName) {
-    QProcess process;
+bool PackageManager::installTransaction(const QStringList &packagePaths, const TransactionCallback &callback) {
+    if (currentPackageManager == PackageManagerType::Unknown) {
+        errorMessage = "未检测到包管理器";
+        logger->error(errorMessage);
+        return false;
+    }
+    
+    logger->info(QString("单事务安装 %1 个软件包").arg(packagePaths.size()));
+    
+    if (!checkLocalInstall(packagePaths)) {
+        return false;
+    }
+    
+    QString command = "sudo";
+    QStringList arguments;
+    bool apt = false;
     
     switch (currentPackageManager) {
     case PackageManagerType::APT:
-        process.start("dpkg", QStringList() << "-l" << packageName);
+        // apt-get has a stable interface; Status-Fd gives machine-readable progress
+        apt = true;
+        arguments << "apt-get" << "install" << "-y"
+                  << "-o" << "APT::Status-Fd=1"
+                  << "-o" << "Dpkg::Use-Pty=0"
+                  << packagePaths;
         break;
     case PackageManagerType::YUM:
+        arguments << "yum" << "install" << "-y" << packagePaths;
+        break;
     case PackageManagerType::DNF:
-        process.start("rpm", QStringList() << "-q" << packageName);
+        arguments << "dnf" << "install" << "-y" << packagePaths;
         break;
     default:
+        errorMessage = "未知的包管理器";
+        logger->error(errorMessage);
         return false;
     }
     
-    if (process.waitForFinished()) {
-        return process.exitCode() == 0;
+    // Not cancellable: the transaction is left to finish once started
+    ProcessRunner runner(logger);
+    runner.setTimeout(kInstallTimeoutMs);
+    
+    // Consume output as it arrives so progress follows the transaction
+    QObject::connect(&runner, &ProcessRunner::standardOutputLine, [&](const QString &line) {
+        TransactionProgress progress;
+        bool parsed = apt ? parseAptStatus(line, progress) : parseRpmTransaction(line, progress);
+        if (parsed) {
+            if (callback) {
+                callback(progress);
+            }
+        } else if (line.startsWith("pmerror:")) {
+            logger->error(line.mid(8));
+        } else if (outputHandler) {
+            outputHandler(line);
+        }
+    });
+    QObject::connect(&runner, &ProcessRunner::standardErrorLine, [&](const QString &line) {
+        if (outputHandler) {
+            outputHandler(line);
+        }
+    });
+    
+    if (!checkResult(runner.run(command, arguments))) {
+        return false;
     }
     
-    return false;
+    logger->info("事务执行成功");
+    return true;
+}
+
+bool PackageManager::isPackageInstalled(const QString &packageName) {
+    return installedIndex->isInstalled(packageName);
 }
 
 bool PackageManager::removePackage(const QString &packageName) {
@@ -133,7 +190,7 @@ bool PackageManager::removePackage(const QString &packageName) {
         return false;
     }
     
-    return executeCommand(command, arguments);
+    return executeCommand(command, arguments, kRemoveTimeoutMs, false);
 }
 
 bool PackageManager::updatePackageDatabase() {
@@ -167,7 +224,7 @@ bool PackageManager::updatePackageDatabase() {
         return false;
     }
     
-    return executeCommand(command, arguments);
+    return executeCommand(command, arguments, kUpdateTimeoutMs, true);
 }
 
 QString PackageManager::getErrorMessage() const {
@@ -187,24 +244,105 @@ QString PackageManager::packageManagerTypeToString(PackageManagerType type) {
     }
 }
 
-bool PackageManager::executeCommand(const QString &command, const QStringList &arguments) {
-    QProcess process;
-    process.start(command, arguments);
+bool PackageManager::parseAptStatus(const QString &line, TransactionProgress &progress) {
+    // The package may carry an ":arch" suffix; the description may contain colons
+    static const QRegularExpression pattern("^pmstatus:([^:]+)(?::[^:0-9][^:]*)?:([0-9.]+):(.*)$");
+    
+    QRegularExpressionMatch match = pattern.match(line);
+    if (!match.hasMatch()) {
+        return false;
+    }
+    
+    progress.package = match.captured(1);
+    progress.percent = qBound(0, static_cast<int>(match.captured(2).toDouble()), 100);
+    progress.action = match.captured(3);
+    return true;
+}
+
+bool PackageManager::parseRpmTransaction(const QString &line, TransactionProgress &progress) {
+    static const QRegularExpression pattern(
+        "^(Installing|Upgrading|Reinstalling|Downgrading|Updating|Erasing|Cleanup|Verifying)\\s*:\\s*(\\S+)\\s+(\\d+)/(\\d+)$");
     
-    if (!process.waitForFinished(-1)) {
-        errorMessage = QString("命令执行失败: %1").arg(process.errorString());
+    QRegularExpressionMatch match = pattern.match(line);
+    if (!match.hasMatch()) {
+        return false;
+    }
+    
+    int step = match.captured(3).toInt();
+    int total = match.captured(4).toInt();
+    if (total <= 0) {
+        return false;
+    }
+    
+    // name-version-release.arch -> name
+    QString nevra = match.captured(2);
+    int dot = nevra.lastIndexOf('.');
+    if (dot > 0) {
+        nevra.truncate(dot);
+    }
+    for (int i = 0; i < 2; ++i) {
+        int dash = nevra.lastIndexOf('-');
+        if (dash > 0) {
+            nevra.truncate(dash);
+        }
+    }
+    
+    progress.package = nevra;
+    progress.action = match.captured(1);
+    progress.percent = qBound(0, step * 100 / total, 100);
+    return true;
+}
+
+bool PackageManager::executeCommand(const QString &command, const QStringList &arguments,
+                                    int timeoutMs, bool cancellable) {
+    ProcessRunner runner(logger);
+    runner.setTimeout(timeoutMs);
+    if (cancellable) {
+        runner.setCancelFlag(cancelFlag);
+    }
+    if (outputHandler) {
+        QObject::connect(&runner, &ProcessRunner::standardOutputLine, outputHandler);
+        QObject::connect(&runner, &ProcessRunner::standardErrorLine, outputHandler);
+    }
+    
+    if (!checkResult(runner.run(command, arguments))) {
+        return false;
+    }
+    
+    logger->info("命令执行成功");
+    return true;
+}
+
+bool PackageManager::checkResult(const ProcessResult &result) {
+    if (!result.started || result.crashed || result.timedOut || result.cancelled) {
+        errorMessage = QString("命令执行失败: %1").arg(result.errorString);
         logger->error(errorMessage);
         return false;
     }
     
-    if (process.exitCode() != 0) {
-        QString output = QString::fromUtf8(process.readAllStandardError());
-        errorMessage = QString("命令执行失败，退出码: %1\n%2").arg(process.exitCode()).arg(output);
+    if (result.exitCode != 0) {
+        QString output = QString::fromUtf8(result.standardError);
+        errorMessage = QString("命令执行失败，退出码: %1\n%2").arg(result.exitCode).arg(output);
         logger->error(errorMessage);
         return false;
     }
     
-    logger->info("命令执行成功");
+    return true;
+}
+
+bool PackageManager::checkLocalInstall(const QStringList &packagePaths) {
+    if (capabilities->supportsLocalInstall()) {
+        return true;
+    }
+    
+    for (const QString &path : packagePaths) {
+        if (QFileInfo(path).isFile()) {
+            errorMessage = QString("%1 不支持直接安装本地软件包文件")
+                .arg(capabilities->describe());
+            logger->error(errorMessage);
+            return false;
+        }
+    }
     return true;
 }
 
@@ -3,9 +3,14 @@
 
 #include <QString>
 #include <QStringList>
+#include <atomic>
+#include <functional>
 #include <memory>
 
 class Logger;
+class InstalledPackageIndex;
+class SystemCapabilities;
+struct ProcessResult;
 
 enum class PackageManagerType {
     APT,    // Debian/Ubuntu
@@ -14,18 +19,43 @@ enum class PackageManagerType {
     Unknown
 };
 
+// Progress reported while a transaction runs
+struct TransactionProgress {
+    QString package;    // package being processed, without version or architecture
+    QString action;     // what the package manager is doing with it
+    int percent = 0;    // overall progress of the transaction
+};
+
+typedef std::function<void(const TransactionProgress &)> TransactionCallback;
+
+// Receives package manager output line by line as it is produced
+typedef std::function<void(const QString &)> OutputHandler;
+
 class PackageManager {
 public:
     explicit PackageManager(std::shared_ptr<Logger> logger);
 
-    // Detect system package manager
+    // Detect system package manager (probed once per process)
     PackageManagerType detectPackageManager();
+
+    // Terminate running commands once *flag becomes true. Commands that
+    // change installed packages are left to finish, so the package
+    // database stays consistent.
+    void setCancelFlag(const std::atomic<bool> *flag);
+
+    // Forward command output to handler as it streams
+    void setOutputHandler(const OutputHandler &handler);
     
     // Install package
     bool installPackage(const QString &packagePath);
     
     // Install multiple packages
     bool installPackages(const QStringList &packagePaths);
+
+    // Install all packages in a single transaction, so locking, database
+    // loading and triggers happen once; progress is parsed from the
+    // package manager's output as it streams
+    bool installTransaction(const QStringList &packagePaths, const TransactionCallback &callback);
     
     // Check if package is installed
     bool isPackageInstalled(const QString &packageName);
@@ -42,12 +72,25 @@ public:
     // Get package manager type string
     static QString packageManagerTypeToString(PackageManagerType type);
 
+    // Parse one APT Status-Fd line ("pmstatus:pkg:percent:description")
+    static bool parseAptStatus(const QString &line, TransactionProgress &progress);
+
+    // Parse one yum/dnf transaction line ("Installing : pkg-1.0-1.x86_64  3/10")
+    static bool parseRpmTransaction(const QString &line, TransactionProgress &progress);
+
 private:
-    bool executeCommand(const QString &command, const QStringList &arguments);
+    bool executeCommand(const QString &command, const QStringList &arguments,
+                        int timeoutMs, bool cancellable);
+    bool checkResult(const ProcessResult &result);
+    bool checkLocalInstall(const QStringList &packagePaths);
     QString getPackageNameFromPath(const QString &packagePath);
 
     std::shared_ptr<Logger> logger;
+    std::shared_ptr<InstalledPackageIndex> installedIndex;
+    std::shared_ptr<SystemCapabilities> capabilities;
     PackageManagerType currentPackageManager;
+    const std::atomic<bool> *cancelFlag;
+    OutputHandler outputHandler;
     QString errorMessage;
 };
 
@@ -1,13 +1,102 @@
 #include "packageparser.h"
 #include "logger.h"
+#include "archivereader.h"
+#include "archiveextractor.h"
+#include "debianversion.h"
+#include "jsonstreamreader.h"
+#include "manifestsidecar.h"
+#include "packageverifier.h"
 
-#include <QFile>
+#include <QByteArrayMatcher>
+#include <QElapsedTimer>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
-#include <QProcess>
-#include <QDir>
-#include <QTemporaryDir>
+#include <QSet>
+#include <climits>
+
+namespace {
+
+QString sha256Hex(const EntryData &entry) {
+    Sha256Hasher hasher;
+    hasher.update(entry.data(), entry.size());
+    return hasher.hexDigest();
+}
+
+// Manifest digests straight from a v2 bundle's TOC
+bool readTocDigests(ArchiveReader &reader, ManifestDigests &digests) {
+    QList<ArchiveEntry> entries;
+    if (!reader.readDirectory(entries)) {
+        return false;
+    }
+    for (const ArchiveEntry &entry : entries) {
+        if (entry.name == "metadata.json") {
+            digests.metadata = entry.digest;
+        } else if (entry.name == "dependencies.json") {
+            digests.dependencies = entry.digest;
+        }
+    }
+    return !digests.metadata.isEmpty();
+}
+
+// Row count to reserve the package table for: one "filename" key per package
+int estimatePackageCount(const char *data, qint64 size) {
+    static const QByteArrayMatcher matcher(QByteArray("\"filename\""));
+    int length = static_cast<int>(qMin<qint64>(size, INT_MAX));
+    int count = 0;
+    int from = 0;
+    while ((from = matcher.indexIn(data, length, from)) >= 0) {
+        ++count;
+        from += matcher.pattern().size();
+    }
+    return count;
+}
+
+// A string field; other types read as empty, as QJsonValue::toString() does
+bool readText(JsonStreamReader &reader, QString &value) {
+    if (reader.peek() != JsonStreamReader::Type::String) {
+        return reader.skipValue();
+    }
+    JsonString text;
+    if (!reader.readString(text)) {
+        return false;
+    }
+    value = text.toString();
+    return true;
+}
+
+// Like readText(), but straight into the string pool
+bool internText(JsonStreamReader &reader, StringPool &pool, quint32 &id) {
+    if (reader.peek() != JsonStreamReader::Type::String) {
+        return reader.skipValue();
+    }
+    JsonString text;
+    if (!reader.readString(text)) {
+        return false;
+    }
+    id = pool.intern(text.data, text.size);
+    return true;
+}
+
+// A size field, given as a number or a numeric string
+bool readSize(JsonStreamReader &reader, qint64 &value) {
+    switch (reader.peek()) {
+    case JsonStreamReader::Type::Number:
+        return reader.readInt64(value);
+    case JsonStreamReader::Type::String: {
+        JsonString text;
+        if (!reader.readString(text)) {
+            return false;
+        }
+        value = QByteArray::fromRawData(text.data, text.size).toLongLong();
+        return true;
+    }
+    default:
+        return reader.skipValue();
+    }
+}
+
+} // namespace
 
 PackageParser::PackageParser(std::shared_ptr<Logger> logger)
     : logger(logger)
@@ -17,31 +106,65 @@ PackageParser::PackageParser(std::shared_ptr<Logger> logger)
 bool PackageParser::parsePackage(const QString &packagePath) {
     logger->info(QString("开始解析软件包: %1").arg(packagePath));
     
-    // Create temporary directory for extraction
-    QTemporaryDir tempDir;
-    if (!tempDir.isValid()) {
-        errorMessage = "无法创建临时目录";
-        logger->error(errorMessage);
-        return false;
+    // Read only the manifests; the payload stays compressed. A v2 bundle
+    // reaches them through its TOC without touching any other entry.
+    ArchiveReader reader(packagePath);
+    ManifestSidecar sidecar(logger);
+    ManifestDigests digests;
+    if (reader.getFormat() == ArchiveReader::Format::BundleV2) {
+        logger->info("检测到 v2 索引格式软件包");
+        // The TOC carries the manifests' digests, so a known bundle is
+        // served from its sidecar without reading the manifests at all
+        if (readTocDigests(reader, digests)
+                && sidecar.load(digests, metadata, dependencies, provides)) {
+            logger->info("软件包解析完成");
+            return true;
+        }
     }
     
-    // Extract archive
-    if (!extractArchive(packagePath, tempDir.path())) {
+    // Stored v2 entries are mapped and parsed in place
+    QMap<QString, EntryData> manifests;
+    if (!reader.mapEntries(QStringList() << "metadata.json" << "dependencies.json", manifests)) {
+        errorMessage = QString("读取压缩包失败: %1").arg(reader.getErrorMessage());
+        logger->error(errorMessage);
         return false;
     }
     
     // Parse metadata
-    QString metadataPath = tempDir.path() + "/metadata.json";
-    if (!parseMetadata(metadataPath)) {
+    if (!manifests.contains("metadata.json")) {
+        errorMessage = "软件包中未找到 metadata.json";
+        logger->error(errorMessage);
+        return false;
+    }
+    const EntryData metadataJson = manifests.value("metadata.json");
+    const EntryData dependenciesJson = manifests.value("dependencies.json");
+    if (digests.metadata.isEmpty()) {
+        digests.metadata = sha256Hex(metadataJson);
+        if (manifests.contains("dependencies.json")) {
+            digests.dependencies = sha256Hex(dependenciesJson);
+        }
+        if (sidecar.load(digests, metadata, dependencies, provides)) {
+            logger->info("软件包解析完成");
+            return true;
+        }
+    }
+    if (metadataJson.isMapped()) {
+        logger->debug("metadata.json 已直接映射，无需复制");
+    }
+    if (!parseMetadata(metadataJson.data(), metadataJson.size())) {
         return false;
     }
     
     // Parse dependencies
-    QString dependenciesPath = tempDir.path() + "/dependencies.json";
-    if (!parseDependencies(dependenciesPath)) {
+    if (!manifests.contains("dependencies.json")
+            || !parseDependencies(QByteArray::fromRawData(dependenciesJson.data(),
+                                                          static_cast<int>(dependenciesJson.size())))) {
         logger->warning("未找到依赖文件，将跳过依赖分析");
     }
     
+    // Next time this manifest loads from the sidecar
+    sidecar.store(digests, metadata, dependencies, provides);
+    
     logger->info("软件包解析完成");
     return true;
 }
@@ -54,67 +177,137 @@ QMap<QString, QStringList> PackageParser::getDependencies() const {
     return dependencies;
 }
 
-bool PackageParser::extractPackage(const QString &packagePath, const QString &extractDir) {
+QMap<QString, QStringList> PackageParser::getProvides() const {
+    return provides;
+}
+
+bool PackageParser::extractPackage(const QString &packagePath, const QString &extractDir,
+                                   const QStringList &entries) {
     logger->info(QString("提取软件包到: %1").arg(extractDir));
-    return extractArchive(packagePath, extractDir);
+    
+    // Hash entries as they stream out so verification needs no second read
+    ArchiveExtractor extractor(logger);
+    extractor.setComputeDigests(true);
+    if (!entries.isEmpty()) {
+        QSet<QString> filter;
+        for (const QString &entry : entries) {
+            filter.insert(entry);
+        }
+        extractor.setEntryFilter(filter);
+        logger->info(QString("仅提取 %1 个文件").arg(entries.size()));
+    }
+    if (!extractor.extract(packagePath, extractDir)) {
+        errorMessage = QString("提取压缩包失败: %1").arg(extractor.getErrorMessage());
+        logger->error(errorMessage);
+        return false;
+    }
+    digests = extractor.getDigests();
+    
+    logger->info(QString("成功提取压缩包到: %1").arg(extractDir));
+    return true;
+}
+
+QMap<QString, QString> PackageParser::getDigests() const {
+    return digests;
 }
 
 QString PackageParser::getErrorMessage() const {
     return errorMessage;
 }
 
-bool PackageParser::parseMetadata(const QString &metadataPath) {
-    QFile metadataFile(metadataPath);
-    if (!metadataFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        errorMessage = QString("无法打开 metadata.json: %1").arg(metadataPath);
-        logger->error(errorMessage);
-        return false;
-    }
+bool PackageParser::parseMetadata(const char *data, qint64 size) {
+    QElapsedTimer timer;
+    timer.start();
     
-    QJsonDocument doc = QJsonDocument::fromJson(metadataFile.readAll());
-    metadataFile.close();
+    // Single pass over the text; no document is built
+    metadata = PackageMetadata();
+    metadata.packages.reserve(estimatePackageCount(data, size));
     
-    if (!doc.isObject()) {
-        errorMessage = "metadata.json 格式无效";
-        logger->error(errorMessage);
-        return false;
+    JsonStreamReader reader(data, size);
+    bool ok = reader.enterObject();
+    JsonString key;
+    while (ok && reader.nextMember(key)) {
+        if (key == "version") {
+            ok = readText(reader, metadata.version);
+        } else if (key == "timestamp") {
+            ok = readText(reader, metadata.timestamp);
+        } else if (key == "targetSystem") {
+            ok = readText(reader, metadata.targetSystem);
+        } else if (key == "targetArchitecture") {
+            ok = readText(reader, metadata.targetArchitecture);
+        } else if (key == "totalSize") {
+            ok = readSize(reader, metadata.totalSize);
+        } else if (key == "packages") {
+            ok = parsePackageList(reader);
+        } else {
+            ok = reader.skipValue();
+        }
     }
     
-    QJsonObject obj = doc.object();
-    metadata.version = obj.value("version").toString();
-    metadata.timestamp = obj.value("timestamp").toString();
-    metadata.targetSystem = obj.value("targetSystem").toString();
-    metadata.targetArchitecture = obj.value("targetArchitecture").toString();
-    metadata.totalSize = obj.value("totalSize").toVariant().toLongLong();
-    
-    // Parse packages array
-    QJsonArray packagesArray = obj.value("packages").toArray();
-    for (const QJsonValue &value : packagesArray) {
-        QJsonObject pkgObj = value.toObject();
-        PackageInfo pkg;
-        pkg.id = pkgObj.value("id").toString();
-        pkg.name = pkgObj.value("name").toString();
-        pkg.version = pkgObj.value("version").toString();
-        pkg.size = pkgObj.value("size").toVariant().toLongLong();
-        pkg.filename = pkgObj.value("filename").toString();
-        pkg.checksum = pkgObj.value("checksum").toString();
-        metadata.packages.append(pkg);
+    if (reader.hasError() || !reader.atEnd()) {
+        errorMessage = QString("metadata.json 格式无效: %1")
+            .arg(reader.hasError() ? reader.getErrorMessage() : "文档后有多余内容");
+        logger->error(errorMessage);
+        metadata = PackageMetadata();
+        return false;
     }
     
     logger->info(QString("解析 metadata 成功，包含 %1 个软件包").arg(metadata.packages.size()));
+    logger->debug(QString("metadata 解析耗时 %1 ms，%2 字节，%3 个不同字符串")
+                  .arg(timer.elapsed()).arg(size).arg(metadata.packages.strings().count()));
     return true;
 }
 
-bool PackageParser::parseDependencies(const QString &dependenciesPath) {
-    QFile dependenciesFile(dependenciesPath);
-    if (!dependenciesFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        errorMessage = QString("无法打开 dependencies.json: %1").arg(dependenciesPath);
-        logger->warning(errorMessage);
-        return false;
+bool PackageParser::parsePackageList(JsonStreamReader &reader) {
+    // Anything but an array means no packages, as QJsonValue::toArray() does
+    if (reader.peek() != JsonStreamReader::Type::Array) {
+        return reader.skipValue();
     }
     
-    QJsonDocument doc = QJsonDocument::fromJson(dependenciesFile.readAll());
-    dependenciesFile.close();
+    StringPool &pool = metadata.packages.strings();
+    reader.enterArray();
+    while (reader.nextElement()) {
+        quint32 id = 0;
+        quint32 name = 0;
+        quint32 version = 0;
+        quint32 filename = 0;
+        quint32 checksum = 0;
+        qint64 size = 0;
+        
+        bool ok = true;
+        if (reader.peek() == JsonStreamReader::Type::Object) {
+            reader.enterObject();
+            JsonString key;
+            while (ok && reader.nextMember(key)) {
+                if (key == "id") {
+                    ok = internText(reader, pool, id);
+                } else if (key == "name") {
+                    ok = internText(reader, pool, name);
+                } else if (key == "version") {
+                    ok = internText(reader, pool, version);
+                } else if (key == "size") {
+                    ok = readSize(reader, size);
+                } else if (key == "filename") {
+                    ok = internText(reader, pool, filename);
+                } else if (key == "checksum") {
+                    ok = internText(reader, pool, checksum);
+                } else {
+                    ok = reader.skipValue();
+                }
+            }
+        } else {
+            ok = reader.skipValue();
+        }
+        if (!ok || reader.hasError()) {
+            return false;
+        }
+        metadata.packages.append(id, name, version, size, filename, checksum);
+    }
+    return !reader.hasError();
+}
+
+bool PackageParser::parseDependencies(const QByteArray &data) {
+    QJsonDocument doc = QJsonDocument::fromJson(data);
     
     if (!doc.isObject()) {
         errorMessage = "dependencies.json 格式无效";
@@ -125,52 +318,32 @@ bool PackageParser::parseDependencies(const QString &dependenciesPath) {
     QJsonObject obj = doc.object();
     QJsonObject depsObj = obj.value("dependencies").toObject();
     
+    // Plain names are relations without a version, so old bundles still parse
+    DependencyAlternatives alternatives;
     for (const QString &key : depsObj.keys()) {
         QJsonArray depsArray = depsObj.value(key).toArray();
         QStringList depsList;
         for (const QJsonValue &value : depsArray) {
-            depsList.append(value.toString());
+            QString relation = value.toString();
+            if (!parseRelation(relation, alternatives)) {
+                logger->warning(QString("无法解析依赖关系: %1 -> %2").arg(key, relation));
+                continue;
+            }
+            depsList.append(relation);
         }
         dependencies[key] = depsList;
     }
     
-    logger->info(QString("解析依赖关系成功，共 %1 个包").arg(dependencies.size()));
-    return true;
-}
-
-bool PackageParser::extractArchive(const QString &archivePath, const QString &extractDir) {
-    // Determine archive type
-    QString archiveType;
-    if (archivePath.endsWith(".tar.gz")) {
-        archiveType = "tar.gz";
-    } else if (archivePath.endsWith(".zip")) {
-        archiveType = "zip";
-    } else {
-        errorMessage = "不支持的压缩格式";
-        logger->error(errorMessage);
-        return false;
-    }
-    
-    // Extract using appropriate tool
-    QProcess process;
-    if (archiveType == "tar.gz") {
-        process.start("tar", QStringList() << "-xzf" << archivePath << "-C" << extractDir);
-    } else if (archiveType == "zip") {
-        process.start("unzip", QStringList() << "-q" << archivePath << "-d" << extractDir);
-    }
-    
-    if (!process.waitForFinished()) {
-        errorMessage = QString("提取压缩包失败: %1").arg(process.errorString());
-        logger->error(errorMessage);
-        return false;
-    }
-    
-    if (process.exitCode() != 0) {
-        errorMessage = QString("提取压缩包失败，退出码: %1").arg(process.exitCode());
-        logger->error(errorMessage);
-        return false;
+    QJsonObject providesObj = obj.value("provides").toObject();
+    for (const QString &key : providesObj.keys()) {
+        QStringList providesList;
+        for (const QJsonValue &value : providesObj.value(key).toArray()) {
+            providesList.append(value.toString());
+        }
+        provides[key] = providesList;
     }
     
-    logger->info(QString("成功提取压缩包到: %1").arg(extractDir));
+    logger->info(QString("解析依赖关系成功，共 %1 个包，%2 个包声明了虚拟包")
+                 .arg(dependencies.size()).arg(provides.size()));
     return true;
 }
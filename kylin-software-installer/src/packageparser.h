@@ -1,59 +1,61 @@
 #ifndef PACKAGEPARSER_H
 #define PACKAGEPARSER_H
 
+#include "packagetable.h"
+
 #include <QString>
-#include <QJsonObject>
-#include <QJsonArray>
 #include <QMap>
 #include <memory>
 
 class Logger;
-
-struct PackageInfo {
-    QString id;
-    QString name;
-    QString version;
-    qint64 size;
-    QString filename;
-    QString checksum;
-};
+class JsonStreamReader;
 
 struct PackageMetadata {
     QString version;
     QString timestamp;
     QString targetSystem;
     QString targetArchitecture;
-    QList<PackageInfo> packages;
-    qint64 totalSize;
+    PackageTable packages;
+    qint64 totalSize = 0;
 };
 
 class PackageParser {
 public:
     explicit PackageParser(std::shared_ptr<Logger> logger);
 
-    // Parse package archive
+    // Parse package manifests without unpacking the payload
     bool parsePackage(const QString &packagePath);
     
     // Get parsed metadata
     PackageMetadata getMetadata() const;
     
-    // Get dependencies
+    // Get dependencies: Debian-style relations per package, e.g.
+    // "libc6 (>= 2.31)" or "default-mta | mail-transport-agent"
     QMap<QString, QStringList> getDependencies() const;
     
-    // Extract package to directory
-    bool extractPackage(const QString &packagePath, const QString &extractDir);
+    // Get virtual packages each bundled package provides, e.g. "mta (= 1.0)"
+    QMap<QString, QStringList> getProvides() const;
+    
+    // Extract package to directory; with entries given, only those files
+    bool extractPackage(const QString &packagePath, const QString &extractDir,
+                        const QStringList &entries = QStringList());
+    
+    // Get SHA-256 digests of files written by the last extraction
+    QMap<QString, QString> getDigests() const;
     
     // Get error message
     QString getErrorMessage() const;
 
 private:
-    bool parseMetadata(const QString &metadataPath);
-    bool parseDependencies(const QString &dependenciesPath);
-    bool extractArchive(const QString &archivePath, const QString &extractDir);
+    bool parseMetadata(const char *data, qint64 size);
+    bool parsePackageList(JsonStreamReader &reader);
+    bool parseDependencies(const QByteArray &data);
 
     std::shared_ptr<Logger> logger;
     PackageMetadata metadata;
     QMap<QString, QStringList> dependencies;
+    QMap<QString, QStringList> provides;
+    QMap<QString, QString> digests;
     QString errorMessage;
 };
 
@@ -0,0 +1,314 @@
+#include "packagesession.h"
+#include "logger.h"
+#include "extractioncache.h"
+#include "diskspaceplanner.h"
+#include "packageverifier.h"
+
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+PackageSession::PackageSession(std::shared_ptr<Logger> logger)
+    : logger(logger)
+    , cache(std::make_unique<ExtractionCache>(logger))
+    , cacheKeyed(false)
+    , extractedAll(false)
+    , fileSize(-1)
+    , loaded(false)
+{
+}
+
+PackageSession::~PackageSession() = default;
+
+bool PackageSession::open(const QString &packagePath) {
+    QMutexLocker locker(&mutex);
+    if (loaded && this->packagePath == packagePath && matchesFile()) {
+        logger->debug(QString("复用已解析的软件包: %1").arg(packagePath));
+        return true;
+    }
+
+    reset();
+
+    QFileInfo fileInfo(packagePath);
+    if (!fileInfo.exists()) {
+        errorMessage = QString("软件包不存在: %1").arg(packagePath);
+        logger->error(errorMessage);
+        return false;
+    }
+
+    // The parser serves known manifests from their sidecar
+    PackageParser parser(logger);
+    if (!parser.parsePackage(packagePath)) {
+        errorMessage = parser.getErrorMessage();
+        return false;
+    }
+
+    metadata = parser.getMetadata();
+    dependencies = parser.getDependencies();
+    provides = parser.getProvides();
+
+    this->packagePath = packagePath;
+    fileSize = fileInfo.size();
+    lastModified = fileInfo.lastModified();
+    loaded = true;
+
+    logger->info(QString("软件包会话已建立: %1").arg(packagePath));
+    return true;
+}
+
+bool PackageSession::isCurrent() const {
+    QMutexLocker locker(&mutex);
+    return matchesFile();
+}
+
+bool PackageSession::matchesFile() const {
+    if (!loaded) {
+        return false;
+    }
+
+    QFileInfo fileInfo(packagePath);
+    return fileInfo.exists()
+        && fileInfo.size() == fileSize
+        && fileInfo.lastModified() == lastModified;
+}
+
+bool PackageSession::ensureExtracted(const QStringList &packageNames) {
+    QMutexLocker locker(&mutex);
+    if (!loaded) {
+        errorMessage = "软件包尚未解析";
+        logger->error(errorMessage);
+        return false;
+    }
+    errorMessage.clear();
+    if (extractedAll) {
+        return true;
+    }
+
+    // Narrow the payload to the requested packages
+    QSet<QString> wanted;
+    wanted.reserve(packageNames.size());
+    for (const QString &name : packageNames) {
+        wanted.insert(name);
+    }
+    PackageTable selected;
+    QStringList entries;
+    for (const PackageInfo &pkg : metadata.packages) {
+        if (wanted.isEmpty() || wanted.contains(pkg.name)) {
+            selected.append(pkg);
+            entries.append("packages/" + pkg.filename);
+        }
+    }
+    bool partial = selected.size() < metadata.packages.size();
+
+    if (!extractDir.isEmpty()) {
+        // Add only what an earlier subset left out
+        PackageTable missing;
+        QStringList missingEntries;
+        for (const PackageInfo &pkg : selected) {
+            if (!extractedPackages.contains(pkg.name)) {
+                missing.append(pkg);
+                missingEntries.append("packages/" + pkg.filename);
+            }
+        }
+        if (missing.isEmpty()) {
+            return true;
+        }
+
+        logger->info(QString("补充解压 %1 个软件包").arg(missing.size()));
+        if (!extractInto(extractDir, missingEntries, missing)) {
+            return false;
+        }
+        for (const PackageInfo &pkg : missing) {
+            extractedPackages.insert(pkg.name);
+        }
+        extractedAll = extractedPackages.size() == metadata.packages.size();
+        return true;
+    }
+
+    // Reuse a payload extracted by an earlier run
+    ensureCacheKey();
+    QString cached = cache->payloadDir(cacheKey);
+    if (!cached.isEmpty()) {
+        logger->info(QString("复用缓存的解压结果: %1").arg(cached));
+        if (!verifyPayload(cached, QMap<QString, QString>(), selected)) {
+            return false;
+        }
+        extractDir = cached;
+        extractedAll = true;
+        return true;
+    }
+
+    if (partial) {
+        if (selected.isEmpty()) {
+            logger->info("没有需要解压的软件包");
+            return true;
+        }
+
+        // The cache only holds complete payloads, so a subset goes to a
+        // temporary directory
+        logger->info(QString("仅解压需要安装的 %1/%2 个软件包")
+                     .arg(selected.size()).arg(metadata.packages.size()));
+        if (!extractToTemporary(entries, selected)) {
+            return false;
+        }
+        for (const PackageInfo &pkg : selected) {
+            extractedPackages.insert(pkg.name);
+        }
+        return true;
+    }
+
+    PackageParser parser(logger);
+    QString staging = cache->beginPayload(cacheKey);
+    if (!staging.isEmpty() && DiskSpacePlanner::availableBytes(staging) < metadata.totalSize) {
+        logger->warning("解压缓存所在磁盘空间不足，改用临时目录");
+        cache->discardPayload(staging);
+        staging.clear();
+    }
+    if (!staging.isEmpty()) {
+        // Only verified payloads are ever published to the cache
+        if (!parser.extractPackage(packagePath, staging)
+                || !verifyPayload(staging, parser.getDigests(), metadata.packages)) {
+            if (errorMessage.isEmpty()) {
+                errorMessage = parser.getErrorMessage();
+            }
+            cache->discardPayload(staging);
+            return false;
+        }
+        if (cache->publishPayload(cacheKey, staging)) {
+            extractDir = cache->payloadDir(cacheKey);
+            extractedAll = true;
+            return true;
+        }
+        logger->warning("解压缓存不可用，改用临时目录");
+    }
+
+    if (!extractToTemporary(QStringList(), metadata.packages)) {
+        return false;
+    }
+    extractedAll = true;
+    return true;
+}
+
+void PackageSession::setWorkDirectory(const QString &parent) {
+    QMutexLocker locker(&mutex);
+    workParent = parent;
+}
+
+bool PackageSession::hasPayload() {
+    QMutexLocker locker(&mutex);
+    if (!loaded) {
+        return false;
+    }
+    if (!extractDir.isEmpty() && extractedAll) {
+        return true;
+    }
+    ensureCacheKey();
+    return !cache->payloadDir(cacheKey).isEmpty();
+}
+
+void PackageSession::ensureCacheKey() {
+    // Hashing a multi-GB bundle takes a while, so it is left to the first
+    // use of the cache, which happens on the install worker
+    if (cacheKeyed) {
+        return;
+    }
+    cacheKeyed = true;
+    if (cache->isAvailable()) {
+        cacheKey = cache->keyFor(packagePath);
+    }
+}
+
+bool PackageSession::extractToTemporary(const QStringList &entries, const PackageTable &packages) {
+    auto dir = workParent.isEmpty()
+        ? std::make_unique<QTemporaryDir>()
+        : std::make_unique<QTemporaryDir>(workParent + "/kylin-installer-XXXXXX");
+    if (!dir->isValid()) {
+        errorMessage = QString("无法创建临时目录: %1").arg(dir->errorString());
+        logger->error(errorMessage);
+        return false;
+    }
+
+    if (!extractInto(dir->path(), entries, packages)) {
+        return false;
+    }
+
+    tempDir = std::move(dir);
+    extractDir = tempDir->path();
+    return true;
+}
+
+bool PackageSession::extractInto(const QString &dir, const QStringList &entries,
+                                 const PackageTable &packages) {
+    PackageParser parser(logger);
+    if (!parser.extractPackage(packagePath, dir, entries)) {
+        errorMessage = parser.getErrorMessage();
+        return false;
+    }
+    return verifyPayload(dir, parser.getDigests(), packages);
+}
+
+bool PackageSession::verifyPayload(const QString &dir, const QMap<QString, QString> &digests,
+                                   const PackageTable &packages) {
+    PackageVerifier verifier(logger);
+    verifier.setKnownDigests(digests);
+    if (!verifier.verifyPackages(dir, packages)) {
+        errorMessage = verifier.getErrorMessage();
+        return false;
+    }
+    return true;
+}
+
+void PackageSession::invalidate() {
+    QMutexLocker locker(&mutex);
+    reset();
+}
+
+void PackageSession::reset() {
+    if (loaded) {
+        logger->info(QString("释放软件包会话: %1").arg(packagePath));
+    }
+
+    tempDir.reset();
+    extractDir.clear();
+    extractedPackages.clear();
+    extractedAll = false;
+    cacheKey.clear();
+    cacheKeyed = false;
+    packagePath.clear();
+    fileSize = -1;
+    lastModified = QDateTime();
+    metadata = PackageMetadata();
+    dependencies.clear();
+    provides.clear();
+    errorMessage.clear();
+    loaded = false;
+}
+
+QString PackageSession::getPackagePath() const {
+    QMutexLocker locker(&mutex);
+    return packagePath;
+}
+
+QString PackageSession::getExtractDir() const {
+    QMutexLocker locker(&mutex);
+    return extractDir;
+}
+
+PackageMetadata PackageSession::getMetadata() const {
+    QMutexLocker locker(&mutex);
+    return metadata;
+}
+
+QMap<QString, QStringList> PackageSession::getDependencies() const {
+    QMutexLocker locker(&mutex);
+    return dependencies;
+}
+
+QMap<QString, QStringList> PackageSession::getProvides() const {
+    QMutexLocker locker(&mutex);
+    return provides;
+}
+
+QString PackageSession::getErrorMessage() const {
+    QMutexLocker locker(&mutex);
+    return errorMessage;
+}
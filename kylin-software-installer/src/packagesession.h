@@ -0,0 +1,92 @@
+#ifndef PACKAGESESSION_H
+#define PACKAGESESSION_H
+
+#include "packageparser.h"
+
+#include <QString>
+#include <QDateTime>
+#include <QMap>
+#include <QStringList>
+#include <QSet>
+#include <QMutex>
+#include <memory>
+
+class Logger;
+class QTemporaryDir;
+class ExtractionCache;
+
+// Holds the parsed state of the currently selected bundle for the whole
+// wizard, so every screen shares one parse and at most one extraction.
+// Both are backed by the persistent ExtractionCache when it is available.
+// The install worker uses it off the GUI thread, so every method locks
+// and the getters return copies.
+class PackageSession {
+public:
+    explicit PackageSession(std::shared_ptr<Logger> logger);
+    ~PackageSession();
+
+    // Open bundle; reuses the previous parse if the file is unchanged
+    bool open(const QString &packagePath);
+
+    // Check that the bundle on disk still matches the parsed state
+    bool isCurrent() const;
+
+    // Unpack and verify the payload on first use; later calls reuse the tree.
+    // With package names given only their files are unpacked, unless a
+    // complete payload is already cached; later calls add what is missing
+    // to the same tree.
+    bool ensureExtracted(const QStringList &packageNames = QStringList());
+
+    // Create temporary extraction directories under parent (see
+    // DiskSpacePlanner)
+    void setWorkDirectory(const QString &parent);
+
+    // Whether a complete payload is already on disk, from this session or
+    // the cache
+    bool hasPayload();
+
+    // Drop parsed state and remove the extracted tree
+    void invalidate();
+
+    // Get parsed state
+    QString getPackagePath() const;
+    QString getExtractDir() const;
+    PackageMetadata getMetadata() const;
+    QMap<QString, QStringList> getDependencies() const;
+    QMap<QString, QStringList> getProvides() const;
+
+    // Get error message
+    QString getErrorMessage() const;
+
+private:
+    bool matchesFile() const;
+    void reset();
+    void ensureCacheKey();
+    bool extractToTemporary(const QStringList &entries, const PackageTable &packages);
+    bool extractInto(const QString &dir, const QStringList &entries, const PackageTable &packages);
+    bool verifyPayload(const QString &dir, const QMap<QString, QString> &digests,
+                       const PackageTable &packages);
+
+    std::shared_ptr<Logger> logger;
+    mutable QMutex mutex;
+    std::unique_ptr<ExtractionCache> cache;
+    std::unique_ptr<QTemporaryDir> tempDir;
+
+    QString packagePath;
+    QString cacheKey;           // computed on first use of the cache
+    bool cacheKeyed;
+    QString extractDir;
+    QString workParent;
+    QSet<QString> extractedPackages;
+    bool extractedAll;
+    qint64 fileSize;
+    QDateTime lastModified;
+
+    PackageMetadata metadata;
+    QMap<QString, QStringList> dependencies;
+    QMap<QString, QStringList> provides;
+    QString errorMessage;
+    bool loaded;
+};
+
+#endif // PACKAGESESSION_H
@@ -0,0 +1,186 @@
+#include "packagetable.h"
+
+#include <QHash>
+#include <cstring>
+
+namespace {
+
+const int kMinSlots = 64;
+
+int slotCountFor(int strings) {
+    // Keep the table at most half full
+    int slots = kMinSlots;
+    while (slots < strings * 2) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+} // namespace
+
+StringPool::StringPool() {
+    slots.fill(0, kMinSlots);
+    offsets.append(0);
+    intern("", 0);
+}
+
+quint32 StringPool::intern(const char *utf8, int size) {
+    uint hash = qHashBits(utf8, static_cast<size_t>(size));
+    int mask = slots.size() - 1;
+
+    for (int slot = static_cast<int>(hash & mask);; slot = (slot + 1) & mask) {
+        quint32 stored = slots.at(slot);
+        if (stored == 0) {
+            break;
+        }
+        quint32 id = stored - 1;
+        quint32 offset = offsets.at(id);
+        int length = static_cast<int>(offsets.at(id + 1) - offset);
+        if (length == size && std::memcmp(arena.constData() + offset, utf8, size) == 0) {
+            return id;
+        }
+    }
+
+    quint32 id = static_cast<quint32>(count());
+    arena.append(utf8, size);
+    offsets.append(static_cast<quint32>(arena.size()));
+
+    if ((count() + 1) * 2 > slots.size()) {
+        rehash(slots.size() * 2);
+    } else {
+        int slot = static_cast<int>(hash & mask);
+        while (slots.at(slot) != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots.set(slot, id + 1);
+    }
+    return id;
+}
+
+quint32 StringPool::intern(const QString &value) {
+    QByteArray utf8 = value.toUtf8();
+    return intern(utf8.constData(), utf8.size());
+}
+
+QString StringPool::value(quint32 id) const {
+    if (id >= static_cast<quint32>(count())) {
+        return QString();
+    }
+    quint32 offset = offsets.at(id);
+    return QString::fromUtf8(arena.constData() + offset, static_cast<int>(offsets.at(id + 1) - offset));
+}
+
+int StringPool::count() const {
+    return offsets.size() - 1;
+}
+
+void StringPool::reserve(int strings) {
+    offsets.reserve(strings + 1);
+    int wanted = slotCountFor(strings);
+    if (wanted > slots.size()) {
+        rehash(wanted);
+    }
+}
+
+uint StringPool::hashOf(quint32 id) const {
+    quint32 offset = offsets.at(id);
+    return qHashBits(arena.constData() + offset, offsets.at(id + 1) - offset);
+}
+
+void StringPool::rehash(int slotCount) {
+    slots.fill(0, slotCount);
+    int mask = slotCount - 1;
+    for (int id = 0; id < count(); ++id) {
+        int slot = static_cast<int>(hashOf(static_cast<quint32>(id)) & mask);
+        while (slots.at(slot) != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots.set(slot, static_cast<quint32>(id) + 1);
+    }
+}
+
+void PackageTable::reserve(int count) {
+    ids.reserve(count);
+    names.reserve(count);
+    versions.reserve(count);
+    sizes.reserve(count);
+    filenames.reserve(count);
+    checksums.reserve(count);
+    // Ids, filenames and checksums are unique per row; names and versions
+    // mostly so
+    pool.reserve(count * 4);
+}
+
+void PackageTable::append(const PackageInfo &pkg) {
+    append(pool.intern(pkg.id), pool.intern(pkg.name), pool.intern(pkg.version), pkg.size,
+           pool.intern(pkg.filename), pool.intern(pkg.checksum));
+}
+
+void PackageTable::append(quint32 id, quint32 name, quint32 version, qint64 size,
+                          quint32 filename, quint32 checksum) {
+    ids.append(id);
+    names.append(name);
+    versions.append(version);
+    sizes.append(size);
+    filenames.append(filename);
+    checksums.append(checksum);
+}
+
+int PackageTable::size() const {
+    return ids.size();
+}
+
+bool PackageTable::isEmpty() const {
+    return ids.isEmpty();
+}
+
+PackageInfo PackageTable::at(int row) const {
+    PackageInfo pkg;
+    pkg.id = id(row);
+    pkg.name = name(row);
+    pkg.version = version(row);
+    pkg.size = packageSize(row);
+    pkg.filename = filename(row);
+    pkg.checksum = checksum(row);
+    return pkg;
+}
+
+QString PackageTable::id(int row) const {
+    return pool.value(ids.at(row));
+}
+
+QString PackageTable::name(int row) const {
+    return pool.value(names.at(row));
+}
+
+QString PackageTable::version(int row) const {
+    return pool.value(versions.at(row));
+}
+
+qint64 PackageTable::packageSize(int row) const {
+    return sizes.at(row);
+}
+
+QString PackageTable::filename(int row) const {
+    return pool.value(filenames.at(row));
+}
+
+QString PackageTable::checksum(int row) const {
+    return pool.value(checksums.at(row));
+}
+
+PackageTable::const_iterator PackageTable::begin() const {
+    return const_iterator(this, 0);
+}
+
+PackageTable::const_iterator PackageTable::end() const {
+    return const_iterator(this, size());
+}
+
+StringPool &PackageTable::strings() {
+    return pool;
+}
+
+const StringPool &PackageTable::strings() const {
+    return pool;
+}
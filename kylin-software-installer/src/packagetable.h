@@ -0,0 +1,167 @@
+#ifndef PACKAGETABLE_H
+#define PACKAGETABLE_H
+
+#include <QString>
+#include <QByteArray>
+#include <cstring>
+#include <memory>
+
+class QFile;
+
+struct PackageInfo {
+    QString id;
+    QString name;
+    QString version;
+    qint64 size;
+    QString filename;
+    QString checksum;
+};
+
+// Column of plain values stored in a QByteArray. A column can wrap mapped
+// memory in place (fromRawData) and is copied only on the first write.
+template <typename T>
+class Column {
+public:
+    static Column fromRawData(const char *data, int count) {
+        Column column;
+        column.bytes = QByteArray::fromRawData(data, count * static_cast<int>(sizeof(T)));
+        return column;
+    }
+
+    T at(int i) const {
+        T value;
+        std::memcpy(&value, bytes.constData() + i * sizeof(T), sizeof(T));
+        return value;
+    }
+
+    void set(int i, T value) {
+        std::memcpy(bytes.data() + i * sizeof(T), &value, sizeof(T));
+    }
+
+    void append(T value) {
+        bytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void fill(T value, int count) {
+        bytes.resize(count * static_cast<int>(sizeof(T)));
+        for (int i = 0; i < count; ++i) {
+            set(i, value);
+        }
+    }
+
+    void reserve(int count) {
+        bytes.reserve(count * static_cast<int>(sizeof(T)));
+    }
+
+    int size() const {
+        return bytes.size() / static_cast<int>(sizeof(T));
+    }
+
+    bool isEmpty() const {
+        return bytes.isEmpty();
+    }
+
+    // Raw bytes, e.g. for writing the column out
+    const QByteArray &raw() const {
+        return bytes;
+    }
+
+private:
+    QByteArray bytes;
+};
+
+// Interned UTF-8 strings stored back to back in one arena. Equal strings
+// share one id; id 0 is always the empty string. A pool loaded from a
+// ManifestSidecar also keeps the mapped file alive for its table.
+class StringPool {
+public:
+    StringPool();
+
+    // Id of the string, adding it if it is new
+    quint32 intern(const char *utf8, int size);
+    quint32 intern(const QString &value);
+
+    // Decoded string of an id
+    QString value(quint32 id) const;
+
+    // Number of distinct strings
+    int count() const;
+
+    // Make room for the given number of distinct strings
+    void reserve(int strings);
+
+private:
+    friend class ManifestSidecar;
+
+    uint hashOf(quint32 id) const;
+    void rehash(int slotCount);
+
+    QByteArray arena;           // UTF-8 text of every string
+    Column<quint32> offsets;    // string i is arena[offsets[i], offsets[i + 1])
+    Column<quint32> slots;      // open-addressed hash of id + 1; 0 = empty
+    std::shared_ptr<QFile> mapping;     // sidecar the pool and its table point into
+};
+
+// Package list of a manifest as one column per field, with the string
+// fields interned. Rows are read back as PackageInfo values. A table
+// loaded from a ManifestSidecar points into the mapped file until it is
+// first modified.
+class PackageTable {
+public:
+    class const_iterator {
+    public:
+        const_iterator(const PackageTable *table, int row) : table(table), row(row) {}
+        PackageInfo operator*() const { return table->at(row); }
+        const_iterator &operator++() { ++row; return *this; }
+        bool operator==(const const_iterator &other) const { return row == other.row; }
+        bool operator!=(const const_iterator &other) const { return row != other.row; }
+
+    private:
+        const PackageTable *table;
+        int row;
+    };
+
+    // Make room for count rows
+    void reserve(int count);
+
+    // Add a row, interning its strings
+    void append(const PackageInfo &pkg);
+
+    // Add a row of already interned strings
+    void append(quint32 id, quint32 name, quint32 version, qint64 size,
+                quint32 filename, quint32 checksum);
+
+    int size() const;
+    bool isEmpty() const;
+
+    // Row as a PackageInfo
+    PackageInfo at(int row) const;
+
+    // Single fields, without building the whole row
+    QString id(int row) const;
+    QString name(int row) const;
+    QString version(int row) const;
+    qint64 packageSize(int row) const;
+    QString filename(int row) const;
+    QString checksum(int row) const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Pool the string columns refer to
+    StringPool &strings();
+    const StringPool &strings() const;
+
+private:
+    friend class ManifestSidecar;
+
+    StringPool pool;
+    Column<quint32> ids;
+    Column<quint32> names;
+    Column<quint32> versions;
+    Column<qint64> sizes;
+    Column<quint32> filenames;
+    Column<quint32> checksums;
+};
+
+#endif // PACKAGETABLE_H
@@ -0,0 +1,202 @@
+#include "packageverifier.h"
+#include "logger.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+#include <openssl/evp.h>
+#include <sys/mman.h>
+
+namespace {
+
+// Hash mapped files in slices so cancellation is noticed promptly
+const qint64 kSliceSize = 8 * 1024 * 1024;
+const qint64 kReadSize = 4 * 1024 * 1024;
+
+double megabytes(qint64 bytes) {
+    return bytes / (1024.0 * 1024);
+}
+
+} // namespace
+
+Sha256Hasher::Sha256Hasher()
+    : context(EVP_MD_CTX_new())
+{
+    EVP_DigestInit_ex(context, EVP_sha256(), nullptr);
+}
+
+Sha256Hasher::~Sha256Hasher() {
+    EVP_MD_CTX_free(context);
+}
+
+void Sha256Hasher::update(const char *data, qint64 size) {
+    EVP_DigestUpdate(context, data, static_cast<size_t>(size));
+}
+
+QString Sha256Hasher::hexDigest() {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_DigestFinal_ex(context, digest, &length);
+    return QString::fromLatin1(QByteArray(reinterpret_cast<const char *>(digest), static_cast<int>(length)).toHex());
+}
+
+PackageVerifier::PackageVerifier(std::shared_ptr<Logger> logger)
+    : logger(logger)
+    , threadCount(qMax(1, QThread::idealThreadCount()))
+    , failed(false)
+{
+}
+
+void PackageVerifier::setThreadCount(int count) {
+    threadCount = qMax(1, count);
+}
+
+void PackageVerifier::setKnownDigests(const QMap<QString, QString> &digests) {
+    knownDigests = digests;
+}
+
+bool PackageVerifier::verifyPackages(const QString &extractDir, const PackageTable &packages) {
+    failed = false;
+    errorMessage.clear();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    std::atomic<qint64> hashedBytes(0);
+    int streamed = 0;
+    int skipped = 0;
+    QList<QFuture<void>> futures;
+
+    for (const PackageInfo &pkg : packages) {
+        QString expected = normalizeChecksum(pkg.checksum);
+        if (expected.isEmpty()) {
+            skipped++;
+            continue;
+        }
+
+        // Digest computed while the entry streamed out of the archive
+        QString entryName = "packages/" + pkg.filename;
+        if (knownDigests.contains(entryName)) {
+            streamed++;
+            if (knownDigests.value(entryName) != expected) {
+                fail(QString("校验失败: %1").arg(pkg.filename));
+                break;
+            }
+            continue;
+        }
+
+        QString path = extractDir + "/" + entryName;
+        futures.append(QtConcurrent::run(&pool, [this, path, expected, pkg, &hashedBytes]() {
+            if (failed) {
+                return;
+            }
+
+            QElapsedTimer fileTimer;
+            fileTimer.start();
+            QString actual = hashFile(path, &failed);
+            if (failed) {
+                return;
+            }
+            if (actual.isEmpty()) {
+                fail(QString("无法读取软件包文件: %1").arg(pkg.filename));
+                return;
+            }
+            if (actual != expected) {
+                fail(QString("校验失败: %1 (期望 %2，实际 %3)").arg(pkg.filename, expected, actual));
+                return;
+            }
+
+            qint64 size = QFile(path).size();
+            qint64 elapsed = qMax<qint64>(1, fileTimer.elapsed());
+            hashedBytes += size;
+            logger->debug(QString("校验通过: %1 (%2 MB, %3 MB/s)")
+                          .arg(pkg.filename)
+                          .arg(megabytes(size), 0, 'f', 1)
+                          .arg(megabytes(size) * 1000.0 / elapsed, 0, 'f', 1));
+        }));
+    }
+
+    for (QFuture<void> &future : futures) {
+        future.waitForFinished();
+    }
+
+    if (failed) {
+        logger->error(errorMessage);
+        return false;
+    }
+
+    qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+    logger->info(QString("校验完成: %1 个文件重新读取 (%2 MB, %3 MB/s)，%4 个在解压时已校验，%5 个无校验和，耗时 %6 ms")
+                 .arg(futures.size())
+                 .arg(megabytes(hashedBytes), 0, 'f', 1)
+                 .arg(megabytes(hashedBytes) * 1000.0 / elapsed, 0, 'f', 1)
+                 .arg(streamed)
+                 .arg(skipped)
+                 .arg(elapsed));
+    if (skipped > 0) {
+        logger->warning(QString("%1 个软件包缺少校验和，未校验").arg(skipped));
+    }
+    return true;
+}
+
+QString PackageVerifier::getErrorMessage() const {
+    return errorMessage;
+}
+
+QString PackageVerifier::hashFile(const QString &path, const std::atomic<bool> *cancel) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+
+    Sha256Hasher hasher;
+    qint64 size = file.size();
+    uchar *mapped = size > 0 ? file.map(0, size) : nullptr;
+
+    if (mapped) {
+        madvise(mapped, static_cast<size_t>(size), MADV_SEQUENTIAL);
+        for (qint64 offset = 0; offset < size; offset += kSliceSize) {
+            if (cancel && *cancel) {
+                return QString();
+            }
+            hasher.update(reinterpret_cast<const char *>(mapped) + offset, qMin(kSliceSize, size - offset));
+        }
+        file.unmap(mapped);
+    } else {
+        QByteArray buffer(static_cast<int>(kReadSize), Qt::Uninitialized);
+        qint64 n;
+        while ((n = file.read(buffer.data(), buffer.size())) > 0) {
+            if (cancel && *cancel) {
+                return QString();
+            }
+            hasher.update(buffer.constData(), n);
+        }
+        if (n < 0) {
+            return QString();
+        }
+    }
+
+    return hasher.hexDigest();
+}
+
+QString PackageVerifier::normalizeChecksum(const QString &checksum) {
+    QString result = checksum.trimmed().toLower();
+    if (result.startsWith("sha256:")) {
+        result = result.mid(7);
+    }
+    return result;
+}
+
+void PackageVerifier::fail(const QString &message) {
+    QMutexLocker locker(&errorMutex);
+    if (errorMessage.isEmpty()) {
+        errorMessage = message;
+    }
+    failed = true;
+}
@@ -0,0 +1,69 @@
+#ifndef PACKAGEVERIFIER_H
+#define PACKAGEVERIFIER_H
+
+#include "packageparser.h"
+
+#include <QString>
+#include <QMap>
+#include <QMutex>
+#include <atomic>
+#include <memory>
+
+class Logger;
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+// Incremental SHA-256 on top of OpenSSL's EVP interface
+class Sha256Hasher {
+public:
+    Sha256Hasher();
+    ~Sha256Hasher();
+
+    Sha256Hasher(const Sha256Hasher &) = delete;
+    Sha256Hasher &operator=(const Sha256Hasher &) = delete;
+
+    void update(const char *data, qint64 size);
+
+    // Finish and return the lowercase hex digest
+    QString hexDigest();
+
+private:
+    EVP_MD_CTX *context;
+};
+
+// Checks every package file against the checksum in metadata.json.
+// Files are hashed concurrently and the first mismatch stops the run.
+class PackageVerifier {
+public:
+    explicit PackageVerifier(std::shared_ptr<Logger> logger);
+
+    // Limit the number of worker threads (defaults to the core count)
+    void setThreadCount(int count);
+
+    // Digests already computed while extracting, keyed by archive entry
+    // name ("packages/foo.deb"); those files are not read again
+    void setKnownDigests(const QMap<QString, QString> &digests);
+
+    // Verify packages extracted under extractDir
+    bool verifyPackages(const QString &extractDir, const PackageTable &packages);
+
+    // Get error message
+    QString getErrorMessage() const;
+
+    // Hash a file with mmap (falls back to large reads); empty on error
+    static QString hashFile(const QString &path, const std::atomic<bool> *cancel = nullptr);
+
+    // Strip an optional "sha256:" prefix and lowercase the hex digest
+    static QString normalizeChecksum(const QString &checksum);
+
+private:
+    void fail(const QString &message);
+
+    std::shared_ptr<Logger> logger;
+    QMap<QString, QString> knownDigests;
+    int threadCount;
+    std::atomic<bool> failed;
+    QMutex errorMutex;
+    QString errorMessage;
+};
+
+#endif // PACKAGEVERIFIER_H
@@ -0,0 +1,279 @@
+#include "processrunner.h"
+#include "logger.h"
+
+#include <QEventLoop>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTimer>
+
+namespace {
+
+const int kDefaultMaxConcurrent = 4;
+const int kSlotRetryMs = 50;
+const int kKillGraceMs = 5000;
+const int kCancelPollMs = 100;
+const int kErrorTailSize = 64 * 1024;
+
+QMutex slotMutex;
+int maxConcurrent = kDefaultMaxConcurrent;
+int activeCount = 0;
+
+} // namespace
+
+ProcessRunner::ProcessRunner(std::shared_ptr<Logger> logger, QObject *parent)
+    : QObject(parent)
+    , logger(logger)
+    , process(new QProcess(this))
+    , timeoutTimer(new QTimer(this))
+    , killTimer(new QTimer(this))
+    , pollTimer(new QTimer(this))
+    , timeout(0)
+    , captureOutput(false)
+    , cancelFlag(nullptr)
+    , running(false)
+    , holdsSlot(false)
+{
+    timeoutTimer->setSingleShot(true);
+    killTimer->setSingleShot(true);
+    pollTimer->setInterval(kCancelPollMs);
+
+    connect(process, &QProcess::readyReadStandardOutput, this, &ProcessRunner::onReadyReadStandardOutput);
+    connect(process, &QProcess::readyReadStandardError, this, &ProcessRunner::onReadyReadStandardError);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &ProcessRunner::onProcessFinished);
+    connect(process, &QProcess::errorOccurred, this, &ProcessRunner::onErrorOccurred);
+    connect(timeoutTimer, &QTimer::timeout, this, &ProcessRunner::onTimeout);
+    connect(killTimer, &QTimer::timeout, process, &QProcess::kill);
+    connect(pollTimer, &QTimer::timeout, this, &ProcessRunner::onPoll);
+}
+
+ProcessRunner::~ProcessRunner() {
+    process->disconnect(this);
+    if (process->state() != QProcess::NotRunning) {
+        process->kill();
+        process->waitForFinished(1000);
+    }
+    if (holdsSlot) {
+        releaseSlot();
+    }
+}
+
+void ProcessRunner::setTimeout(int msecs) {
+    timeout = qMax(0, msecs);
+}
+
+void ProcessRunner::setCaptureOutput(bool enabled) {
+    captureOutput = enabled;
+}
+
+void ProcessRunner::setCancelFlag(const std::atomic<bool> *flag) {
+    cancelFlag = flag;
+}
+
+void ProcessRunner::start(const QString &program, const QStringList &arguments) {
+    if (running) {
+        logger->warning(QString("进程仍在运行，忽略命令: %1").arg(program));
+        return;
+    }
+
+    this->program = program;
+    this->arguments = arguments;
+    currentResult = ProcessResult();
+    pendingOutput.clear();
+    pendingError.clear();
+    running = true;
+
+    if (cancelFlag) {
+        pollTimer->start();
+    }
+    launch();
+}
+
+ProcessResult ProcessRunner::run(const QString &program, const QStringList &arguments) {
+    QEventLoop loop;
+    connect(this, &ProcessRunner::finished, &loop, &QEventLoop::quit);
+
+    start(program, arguments);
+    if (running) {
+        loop.exec();
+    }
+    return currentResult;
+}
+
+bool ProcessRunner::isRunning() const {
+    return running;
+}
+
+const ProcessResult &ProcessRunner::result() const {
+    return currentResult;
+}
+
+void ProcessRunner::setMaxConcurrent(int count) {
+    QMutexLocker locker(&slotMutex);
+    maxConcurrent = qMax(1, count);
+}
+
+void ProcessRunner::terminate() {
+    if (!running) {
+        return;
+    }
+    if (!currentResult.timedOut) {
+        currentResult.cancelled = true;
+    }
+
+    // Still waiting for a slot: nothing to signal
+    if (!holdsSlot) {
+        complete();
+        return;
+    }
+
+    if (killTimer->isActive() || process->state() == QProcess::NotRunning) {
+        return;
+    }
+
+    logger->warning(QString("终止进程: %1").arg(program));
+    process->terminate();
+    killTimer->start(kKillGraceMs);
+}
+
+void ProcessRunner::launch() {
+    // The run may have ended while waiting for a slot
+    if (!running || holdsSlot) {
+        return;
+    }
+    if (cancelFlag && cancelFlag->load()) {
+        currentResult.cancelled = true;
+        complete();
+        return;
+    }
+    if (!acquireSlot()) {
+        QTimer::singleShot(kSlotRetryMs, this, &ProcessRunner::launch);
+        return;
+    }
+    holdsSlot = true;
+
+    logger->debug(QString("执行命令: %1 %2").arg(program, arguments.join(' ')));
+    elapsed.start();
+    process->start(program, arguments);
+    if (timeout > 0) {
+        timeoutTimer->start(timeout);
+    }
+}
+
+void ProcessRunner::onReadyReadStandardOutput() {
+    drain(pendingOutput, false, false);
+}
+
+void ProcessRunner::onReadyReadStandardError() {
+    drain(pendingError, true, false);
+}
+
+void ProcessRunner::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+    drain(pendingOutput, false, true);
+    drain(pendingError, true, true);
+
+    currentResult.started = true;
+    currentResult.exitCode = exitCode;
+    currentResult.crashed = exitStatus == QProcess::CrashExit;
+
+    if (currentResult.timedOut) {
+        currentResult.errorString = QString("超时 (%1 秒)").arg(timeout / 1000);
+        logger->warning(QString("命令超时: %1").arg(program));
+    } else if (currentResult.cancelled) {
+        currentResult.errorString = "已取消";
+    } else if (currentResult.crashed) {
+        currentResult.errorString = process->errorString();
+    }
+
+    logger->debug(QString("命令结束: %1，退出码 %2，用时 %3 ms")
+                  .arg(program).arg(exitCode).arg(elapsed.elapsed()));
+    complete();
+}
+
+void ProcessRunner::onErrorOccurred(QProcess::ProcessError error) {
+    // Every other error is followed by finished()
+    if (error != QProcess::FailedToStart) {
+        return;
+    }
+
+    currentResult.errorString = process->errorString();
+    logger->error(QString("无法启动命令 %1: %2").arg(program, currentResult.errorString));
+    complete();
+}
+
+void ProcessRunner::onTimeout() {
+    currentResult.timedOut = true;
+    terminate();
+}
+
+void ProcessRunner::onPoll() {
+    if (cancelFlag && cancelFlag->load()) {
+        terminate();
+    }
+}
+
+void ProcessRunner::drain(QByteArray &pending, bool errorChannel, bool flush) {
+    QByteArray data = errorChannel ? process->readAllStandardError() : process->readAllStandardOutput();
+    if (errorChannel) {
+        currentResult.standardError.append(data);
+        if (currentResult.standardError.size() > kErrorTailSize) {
+            currentResult.standardError.remove(0, currentResult.standardError.size() - kErrorTailSize);
+        }
+    } else if (captureOutput) {
+        currentResult.standardOutput.append(data);
+    }
+
+    auto emitLine = [&](const QByteArray &raw) {
+        QString line = QString::fromUtf8(raw).trimmed();
+        if (line.isEmpty()) {
+            return;
+        }
+        if (errorChannel) {
+            logger->warning(line);
+            emit standardErrorLine(line);
+        } else {
+            logger->debug(line);
+            emit standardOutputLine(line);
+        }
+    };
+
+    pending.append(data);
+    int start = 0;
+    int newline;
+    while ((newline = pending.indexOf('\n', start)) >= 0) {
+        emitLine(pending.mid(start, newline - start));
+        start = newline + 1;
+    }
+    pending.remove(0, start);
+
+    if (flush && !pending.isEmpty()) {
+        emitLine(pending);
+        pending.clear();
+    }
+}
+
+void ProcessRunner::complete() {
+    timeoutTimer->stop();
+    killTimer->stop();
+    pollTimer->stop();
+    if (holdsSlot) {
+        releaseSlot();
+        holdsSlot = false;
+    }
+    running = false;
+    emit finished();
+}
+
+bool ProcessRunner::acquireSlot() {
+    QMutexLocker locker(&slotMutex);
+    if (activeCount >= maxConcurrent) {
+        return false;
+    }
+    ++activeCount;
+    return true;
+}
+
+void ProcessRunner::releaseSlot() {
+    QMutexLocker locker(&slotMutex);
+    --activeCount;
+}
@@ -0,0 +1,114 @@
+#ifndef PROCESSRUNNER_H
+#define PROCESSRUNNER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+
+class Logger;
+class QTimer;
+
+// Outcome of one subprocess run
+struct ProcessResult {
+    bool started = false;
+    bool timedOut = false;
+    bool cancelled = false;
+    bool crashed = false;
+    int exitCode = -1;
+    QByteArray standardOutput;   // only filled when output capture is on
+    QByteArray standardError;    // tail of stderr, for error messages
+    QString errorString;
+
+    // Check if the process ran to completion with exit code 0
+    bool succeeded() const {
+        return started && !timedOut && !cancelled && !crashed && exitCode == 0;
+    }
+};
+
+// Signal-driven wrapper around QProcess that every subprocess goes
+// through. Output is split into lines and streamed to the logger and the
+// line signals as it arrives; a run can be bounded by a timeout and
+// cancelled (SIGTERM, then SIGKILL after a grace period). The number of
+// subprocesses running at once is capped process-wide; a runner waits,
+// without blocking its thread, until a slot is free.
+class ProcessRunner : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ProcessRunner(std::shared_ptr<Logger> logger, QObject *parent = nullptr);
+    ~ProcessRunner();
+
+    // Terminate the process if it runs longer than msecs (0 = no limit)
+    void setTimeout(int msecs);
+
+    // Keep all of stdout in the result in addition to streaming it
+    void setCaptureOutput(bool enabled);
+
+    // Terminate the process once *flag becomes true (checked while it runs)
+    void setCancelFlag(const std::atomic<bool> *flag);
+
+    // Start asynchronously; finished() is emitted when the run is over
+    void start(const QString &program, const QStringList &arguments);
+
+    // Start and wait for the result; events keep being processed, so the
+    // line signals are delivered while the process runs
+    ProcessResult run(const QString &program, const QStringList &arguments);
+
+    // Check if a run is queued or in progress
+    bool isRunning() const;
+
+    // Result of the last run
+    const ProcessResult &result() const;
+
+    // Limit the number of subprocesses running at once
+    static void setMaxConcurrent(int count);
+
+public slots:
+    // Stop the current run: SIGTERM, then SIGKILL if it does not exit
+    void terminate();
+
+signals:
+    void standardOutputLine(const QString &line);
+    void standardErrorLine(const QString &line);
+    void finished();
+
+private slots:
+    void launch();
+    void onReadyReadStandardOutput();
+    void onReadyReadStandardError();
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onErrorOccurred(QProcess::ProcessError error);
+    void onTimeout();
+    void onPoll();
+
+private:
+    void drain(QByteArray &pending, bool errorChannel, bool flush);
+    void complete();
+
+    static bool acquireSlot();
+    static void releaseSlot();
+
+    std::shared_ptr<Logger> logger;
+    QProcess *process;
+    QTimer *timeoutTimer;
+    QTimer *killTimer;
+    QTimer *pollTimer;
+    QString program;
+    QStringList arguments;
+    int timeout;
+    bool captureOutput;
+    const std::atomic<bool> *cancelFlag;
+    QByteArray pendingOutput;
+    QByteArray pendingError;
+    bool running;
+    bool holdsSlot;
+    QElapsedTimer elapsed;
+    ProcessResult currentResult;
+};
+
+#endif // PROCESSRUNNER_H
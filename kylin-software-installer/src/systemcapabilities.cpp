@@ -0,0 +1,198 @@
+#include "systemcapabilities.h"
+#include "installedpackageindex.h"
+#include "debianversion.h"
+#include "logger.h"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QStandardPaths>
+
+namespace {
+
+const char *const kProbedTools[] = { "apt", "apt-get", "dpkg", "yum", "dnf", "rpm", "sudo" };
+const char *const kOsReleasePaths[] = { "/etc/os-release", "/usr/lib/os-release" };
+
+// Package tools live in sbin on some systems, which a user PATH may lack
+const char *const kFallbackDirs[] = { "/usr/bin", "/usr/sbin", "/bin", "/sbin" };
+
+// First apt release whose install command accepts local .deb files
+const char kAptLocalInstallVersion[] = "1.1";
+
+QString unquote(const QString &value) {
+    if (value.size() >= 2 && (value.startsWith('"') || value.startsWith('\''))
+        && value.endsWith(value.at(0))) {
+        return value.mid(1, value.size() - 2);
+    }
+    return value;
+}
+
+} // namespace
+
+SystemCapabilities::SystemCapabilities(std::shared_ptr<Logger> logger)
+    : logger(logger)
+    , manager(PackageManagerType::Unknown)
+    , versionsProbed(false)
+    , localInstall(false)
+{
+    probeTools();
+    readOsRelease();
+
+    logger->info(QString("系统: %1，包管理器: %2")
+                 .arg(prettyName.isEmpty() ? id : prettyName)
+                 .arg(PackageManager::packageManagerTypeToString(manager)));
+}
+
+std::shared_ptr<SystemCapabilities> SystemCapabilities::instance(std::shared_ptr<Logger> logger) {
+    static QMutex mutex;
+    static std::shared_ptr<SystemCapabilities> shared;
+
+    QMutexLocker locker(&mutex);
+    if (!shared) {
+        shared = std::make_shared<SystemCapabilities>(logger);
+    }
+    return shared;
+}
+
+PackageManagerType SystemCapabilities::packageManager() const {
+    return manager;
+}
+
+QString SystemCapabilities::toolPath(const QString &tool) const {
+    return tools.value(tool);
+}
+
+bool SystemCapabilities::hasTool(const QString &tool) const {
+    return tools.contains(tool);
+}
+
+QString SystemCapabilities::osId() const {
+    return id;
+}
+
+QString SystemCapabilities::osVersion() const {
+    return versionId;
+}
+
+QString SystemCapabilities::osName() const {
+    return prettyName;
+}
+
+QStringList SystemCapabilities::osFamily() const {
+    return idLike;
+}
+
+QString SystemCapabilities::packageManagerVersion() {
+    probeVersions();
+    QMutexLocker locker(&versionMutex);
+    return managerVersion;
+}
+
+bool SystemCapabilities::supportsLocalInstall() {
+    probeVersions();
+    QMutexLocker locker(&versionMutex);
+    return localInstall;
+}
+
+QString SystemCapabilities::describe() {
+    QString version = packageManagerVersion();
+    return QString("%1 %2 (%3)")
+        .arg(PackageManager::packageManagerTypeToString(manager))
+        .arg(version.isEmpty() ? "?" : version)
+        .arg(prettyName.isEmpty() ? id : prettyName);
+}
+
+void SystemCapabilities::probeTools() {
+    QStringList fallbackDirs;
+    for (const char *dir : kFallbackDirs) {
+        fallbackDirs.append(dir);
+    }
+
+    for (const char *tool : kProbedTools) {
+        QString path = QStandardPaths::findExecutable(tool);
+        if (path.isEmpty()) {
+            path = QStandardPaths::findExecutable(tool, fallbackDirs);
+        }
+        if (!path.isEmpty()) {
+            tools.insert(tool, path);
+        }
+    }
+
+    // Same preference order as the old `which` probe
+    if (hasTool("apt")) {
+        manager = PackageManagerType::APT;
+    } else if (hasTool("yum")) {
+        manager = PackageManagerType::YUM;
+    } else if (hasTool("dnf")) {
+        manager = PackageManagerType::DNF;
+    }
+}
+
+void SystemCapabilities::readOsRelease() {
+    for (const char *path : kOsReleasePaths) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            continue;
+        }
+
+        while (!file.atEnd()) {
+            QString line = QString::fromUtf8(file.readLine()).trimmed();
+            int equals = line.indexOf('=');
+            if (line.startsWith('#') || equals <= 0) {
+                continue;
+            }
+
+            QString key = line.left(equals);
+            QString value = unquote(line.mid(equals + 1));
+            if (key == "ID") {
+                id = value;
+            } else if (key == "VERSION_ID") {
+                versionId = value;
+            } else if (key == "PRETTY_NAME") {
+                prettyName = value;
+            } else if (key == "ID_LIKE") {
+                idLike = value.split(' ', QString::SkipEmptyParts);
+            }
+        }
+        return;
+    }
+
+    logger->warning("无法读取 os-release");
+}
+
+void SystemCapabilities::probeVersions() {
+    {
+        QMutexLocker locker(&versionMutex);
+        if (versionsProbed) {
+            return;
+        }
+    }
+
+    // The index may run `rpm -qa` in a nested event loop, so look up
+    // without the lock; concurrent probes just find the same answer
+    std::shared_ptr<InstalledPackageIndex> index = InstalledPackageIndex::instance(logger);
+    QString version;
+    bool local = false;
+    switch (manager) {
+    case PackageManagerType::APT:
+        version = index->installedVersion("apt");
+        // Unknown version: assume a current apt rather than refuse
+        local = version.isEmpty()
+            || DebianVersion::compare(version, kAptLocalInstallVersion) >= 0;
+        break;
+    case PackageManagerType::YUM:
+        version = index->installedVersion("yum");
+        local = true;
+        break;
+    case PackageManagerType::DNF:
+        version = index->installedVersion("dnf");
+        local = true;
+        break;
+    default:
+        break;
+    }
+
+    QMutexLocker locker(&versionMutex);
+    managerVersion = version;
+    localInstall = local;
+    versionsProbed = true;
+}
@@ -0,0 +1,72 @@
+#ifndef SYSTEMCAPABILITIES_H
+#define SYSTEMCAPABILITIES_H
+
+#include "packagemanager.h"
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMutex>
+#include <memory>
+
+class Logger;
+class InstalledPackageIndex;
+
+// What the host system offers, probed once per process and shared by
+// every component: package management tools found on PATH (no process
+// is spawned), /etc/os-release, and the package manager's version and
+// features. Versions come from the installed package index and are read
+// on first use.
+class SystemCapabilities {
+public:
+    explicit SystemCapabilities(std::shared_ptr<Logger> logger);
+
+    // Process-wide capabilities
+    static std::shared_ptr<SystemCapabilities> instance(std::shared_ptr<Logger> logger);
+
+    // Package manager used for installs
+    PackageManagerType packageManager() const;
+
+    // Absolute path of a probed tool ("apt", "dpkg", "rpm", "sudo"...), empty if missing
+    QString toolPath(const QString &tool) const;
+
+    // Check if a probed tool is available
+    bool hasTool(const QString &tool) const;
+
+    // os-release ID, VERSION_ID, PRETTY_NAME and ID_LIKE
+    QString osId() const;
+    QString osVersion() const;
+    QString osName() const;
+    QStringList osFamily() const;
+
+    // Installed version of the package manager itself, empty if unknown
+    QString packageManagerVersion();
+
+    // Whether install accepts local package files ("apt install ./file.deb"
+    // needs apt 1.1; yum and dnf always could)
+    bool supportsLocalInstall();
+
+    // One-line summary for logs
+    QString describe();
+
+private:
+    void probeTools();
+    void readOsRelease();
+    void probeVersions();
+
+    std::shared_ptr<Logger> logger;
+    QHash<QString, QString> tools;
+    PackageManagerType manager;
+    QString id;
+    QString versionId;
+    QString prettyName;
+    QStringList idLike;
+
+    // Filled by probeVersions(), guarded by versionMutex
+    QMutex versionMutex;
+    bool versionsProbed;
+    QString managerVersion;
+    bool localInstall;
+};
+
+#endif // SYSTEMCAPABILITIES_H